@@ -0,0 +1,106 @@
+/* A bump allocator.  Memory is carved out of large blocks & is only ever
+	released all at once, which makes allocating many small, long-lived
+	objects (identifiers, token lists, table slots) nearly free. */
+#include <span>
+using std::span;
+struct KArena
+{
+	struct Block
+	{
+		Block* previous;
+		size_t capacity;
+		size_t used;
+	};
+	Block* current;
+};
+static const size_t KARENA_BLOCK_SIZE = 64*1024;
+static void* karenaAllocate(KArena& arena, size_t size, size_t alignment)
+{
+	KArena::Block* block = arena.current;
+	if(block)
+	{
+		const uintptr_t base = reinterpret_cast<uintptr_t>(block + 1);
+		const size_t offset =
+			((base + block->used + alignment - 1) & ~(alignment - 1)) - base;
+		if(offset + size <= block->capacity)
+		{
+			block->used = offset + size;
+			return reinterpret_cast<void*>(base + offset);
+		}
+	}
+	const size_t capacity = std::max(KARENA_BLOCK_SIZE, size + alignment);
+	block = static_cast<KArena::Block*>(
+		malloc(sizeof(KArena::Block) + capacity));
+	if(!block)
+	{
+		fprintf(stderr, "Failed to alloc %zu bytes!\n",
+		        sizeof(KArena::Block) + capacity);
+		exit(EXIT_FAILURE);
+	}
+	block->previous = arena.current;
+	block->capacity = capacity;
+	block->used     = 0;
+	arena.current = block;
+	return karenaAllocate(arena, size, alignment);
+}
+template<class T>
+static span<const T> karenaPushArray(KArena& arena, const T* data,
+                                     size_t count)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	if(count == 0)
+		return {};
+	T*const result = static_cast<T*>(
+		karenaAllocate(arena, count*sizeof(T), alignof(T)));
+	memcpy(result, data, count*sizeof(T));
+	return {result, count};
+}
+static string_view karenaPushString(KArena& arena, string_view str)
+{
+	const span<const char> chars =
+		karenaPushArray(arena, str.data(), str.size());
+	return {chars.data(), chars.size()};
+}
+static void karenaFree(KArena& arena)
+{
+	while(arena.current)
+	{
+		KArena::Block*const previous = arena.current->previous;
+		free(arena.current);
+		arena.current = previous;
+	}
+}
+/* A growable array whose storage comes from an arena.  When it grows, the old
+	storage is simply abandoned; since the capacity doubles, this wastes at
+	most as much memory as the array itself uses. */
+template<class T>
+struct KArenaArray
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	T* data;
+	uint32_t count;
+	uint32_t capacity;
+	T& operator[](size_t i) { assert(i < count); return data[i]; }
+	const T& operator[](size_t i) const { assert(i < count); return data[i]; }
+};
+template<class T>
+static void karenaArrayResize(KArena& arena, KArenaArray<T>& array,
+                              uint32_t capacity)
+{
+	T*const data = static_cast<T*>(
+		karenaAllocate(arena, capacity*sizeof(T), alignof(T)));
+	if(array.count)
+		memcpy(data, array.data, array.count*sizeof(T));
+	array.data     = data;
+	array.capacity = capacity;
+}
+/** @return the index of the new element */
+template<class T>
+static uint32_t karenaArrayPush(KArena& arena, KArenaArray<T>& array,
+                                const T& value)
+{
+	if(array.count == array.capacity)
+		karenaArrayResize(arena, array, std::max(16u, array.capacity*2));
+	array.data[array.count] = value;
+	return array.count++;
+}
@@ -0,0 +1,398 @@
+/* Micro-benchmarks for kcpp's hot paths.  Run with `kcpp --benchmark`,
+	optionally followed by a semicolon-separated list of directories whose
+	files should be used as additional tokenizer input.  Build with
+	optimizations enabled (/O2) for meaningful results! */
+#include <limits>
+/* The original comparison-chain tokenizer, kept as the baseline which the
+	table-driven `ktokeNext` is measured against. */
+static bool benchLegacyIsEndOfLine(char c)
+{
+	return c == '\r' || c == '\n';
+}
+static bool benchLegacyIsWhitespace(char c)
+{
+	return c == ' ' || c == '\t' || benchLegacyIsEndOfLine(c);
+}
+static bool benchLegacyIsAlpha(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+static bool benchLegacyIsNumeric(char c)
+{
+	return c >= '0' && c <= '9';
+}
+static KToken benchLegacyParseComment(KTokenizer& tokenizer)
+{
+	KToken result = {
+		.type = KTokenType::COMMENT,
+		.textLength = 2,
+		.text = tokenizer.at
+	};
+	if(tokenizer.at[1] == '/')
+	{
+		tokenizer.at += 2;
+		while(tokenizer.at[0] && !benchLegacyIsEndOfLine(tokenizer.at[0]))
+		{
+			tokenizer.at++;
+			result.textLength++;
+		}
+		return result;
+	}
+	tokenizer.at += 2;
+	while(tokenizer.at[0] && 
+		!(tokenizer.at[0] == '*' && tokenizer.at[1] == '/'))
+	{
+		tokenizer.at++;
+		result.textLength++;
+	}
+	if(tokenizer.at[0] == '*')
+	{
+		tokenizer.at += 2;
+		result.textLength += 2;
+	}
+	return result;
+}
+static KToken benchLegacyKtokeNext(KTokenizer& tokenizer)
+{
+	KToken result = {
+		.type = KTokenType::UNKNOWN,
+		.textLength = 1,
+		.text = tokenizer.at
+	};
+	if(benchLegacyIsWhitespace(tokenizer.at[0]))
+	{
+		result.type = KTokenType::WHITESPACE;
+		result.textLength = 0;
+		while(benchLegacyIsWhitespace(tokenizer.at[0]))
+		{
+			tokenizer.at++;
+			result.textLength++;
+		}
+		return result;
+	}
+	switch(tokenizer.at[0])
+	{
+		case '\0': result.type = KTokenType::END_OF_STREAM; tokenizer.at++; break;
+		case '(':  result.type = KTokenType::PAREN_OPEN;    tokenizer.at++; break;
+		case ')':  result.type = KTokenType::PAREN_CLOSE;   tokenizer.at++; break;
+		case ':':  result.type = KTokenType::COLON;         tokenizer.at++; break;
+		case ',':  result.type = KTokenType::COMMA;         tokenizer.at++; break;
+		case ';':  result.type = KTokenType::SEMICOLON;     tokenizer.at++; break;
+		case '*':  result.type = KTokenType::ASTERISK;      tokenizer.at++; break;
+		case '[':  result.type = KTokenType::BRACKET_OPEN;  tokenizer.at++; break;
+		case ']':  result.type = KTokenType::BRACKET_CLOSE; tokenizer.at++; break;
+		case '{':  result.type = KTokenType::BRACE_OPEN;    tokenizer.at++; break;
+		case '}':  result.type = KTokenType::BRACE_CLOSE;   tokenizer.at++; break;
+		case '#':  result.type = KTokenType::HASH_TAG;      tokenizer.at++; break;
+		case '/':
+		{
+			if(tokenizer.at[1] == '/' || tokenizer.at[1] == '*')
+			{
+				return benchLegacyParseComment(tokenizer);
+			}
+			tokenizer.at++;
+		}break;
+		case '"':
+		case '\'':
+		{
+			const char quote = tokenizer.at[0];
+			result.type = quote == '"'
+				? KTokenType::STRING : KTokenType::CHARACTER;
+			result.textLength = 0;
+			tokenizer.at++;
+			result.text = tokenizer.at;
+			while(tokenizer.at[0] && tokenizer.at[0] != quote)
+			{
+				if(tokenizer.at[0] == '\\' && tokenizer.at[1])
+				{
+					tokenizer.at++; result.textLength++;
+				}
+				tokenizer.at++; result.textLength++;
+			}
+			if(tokenizer.at[0] == quote)
+			{
+				tokenizer.at++;
+			}
+		}break;
+		default:
+		{
+			if(benchLegacyIsAlpha(tokenizer.at[0]))
+			{
+				result.type = KTokenType::IDENTIFIER;
+				tokenizer.at++;
+				while(benchLegacyIsAlpha(tokenizer.at[0]) ||
+					benchLegacyIsNumeric(tokenizer.at[0]))
+				{
+					tokenizer.at++;
+					result.textLength++;
+				}
+			}
+			else
+			{
+				tokenizer.at++;
+			}
+		}break;
+	}
+	return result;
+}
+using BenchNextTokenFunction = KToken (*)(KTokenizer&);
+/* Both tokenizers are always called through this pointer, so neither one can 
+	be inlined into the benchmark loop; the parsers call `ktokeNext` from many 
+	places, so this matches how it is actually used. */
+static BenchNextTokenFunction volatile g_benchNextToken;
+/** Tokenize `data` until END_OF_STREAM `iterations` times.
+ * @return a checksum of the token stream, so that the work can't be optimized
+ *         away & so both tokenizers can be verified to agree */
+static uint64_t benchTokenize(const string& data, int iterations)
+{
+	const BenchNextTokenFunction nextToken = g_benchNextToken;
+	uint64_t checksum = 0;
+	for(int i = 0; i < iterations; i++)
+	{
+		KTokenizer tokenizer = {.at = data.c_str()};
+		for(;;)
+		{
+			const KToken token = nextToken(tokenizer);
+			checksum = checksum*31 + static_cast<uint64_t>(token.type)*7 +
+				static_cast<uint64_t>(token.textLength);
+			if(token.type == KTokenType::END_OF_STREAM)
+				break;
+		}
+	}
+	return checksum;
+}
+static double benchTokenizerMegabytesPerSecond(
+	BenchNextTokenFunction nextToken, const string& data, int iterations, 
+	uint64_t& outChecksum)
+{
+	g_benchNextToken = nextToken;
+	const auto timeStart = chrono::high_resolution_clock::now();
+	outChecksum = benchTokenize(data, iterations);
+	const auto timeEnd = chrono::high_resolution_clock::now();
+	const double seconds =
+		chrono::duration<double>(timeEnd - timeStart).count();
+	const double megabytes =
+		static_cast<double>(data.size())*iterations / (1024.0*1024.0);
+	return megabytes / seconds;
+}
+static string benchGenerateSyntheticSource(size_t minimumSize)
+{
+	static const char*const SNIPPET =
+		"/* synthetic benchmark source */\n"
+		"#include \"actor.h\"\n"
+		"internal void actorUpdate(Actor* actor, f32 deltaSeconds)\n"
+		"{\n"
+		"\t// integrate the actor's position\n"
+		"\tactor->position.x += actor->velocity.x * deltaSeconds;\n"
+		"\tactor->position.y += actor->velocity.y * deltaSeconds;\n"
+		"\tif(actor->hitPoints <= 0 && !actor->isDead)\n"
+		"\t{\n"
+		"\t\tKLOG(INFO, \"actor '%s' died!\", actor->name);\n"
+		"\t\tactor->isDead = true;\n"
+		"\t}\n"
+		"\tconst char c = '\\n';\n"
+		"\tfor(u32 i = 0; i < CARRAY_SIZE(actor->items); i++)\n"
+		"\t\tactorItemUpdate(&actor->items[i], deltaSeconds);\n"
+		"}\n"
+		"\n";
+	string result;
+	result.reserve(minimumSize + strlen(SNIPPET));
+	while(result.size() < minimumSize)
+		result.append(SNIPPET);
+	return result;
+}
+static bool benchRunTokenizer(const string& data, const char* dataName)
+{
+	/* tokenize ~64MB per round, alternating between the tokenizers each 
+		round & keeping the best result to reduce the noise from other 
+		processes */
+	const int rounds = 5;
+	const int iterations = static_cast<int>(
+		std::max<size_t>(1, (64*1024*1024) / std::max<size_t>(1, data.size())));
+	double mbpsLegacy = 0;
+	double mbpsTable  = 0;
+	uint64_t checksumLegacy;
+	uint64_t checksumTable;
+	for(int r = 0; r < rounds; r++)
+	{
+		mbpsLegacy = std::max(mbpsLegacy, 
+			benchTokenizerMegabytesPerSecond(
+				benchLegacyKtokeNext, data, iterations, checksumLegacy));
+		mbpsTable = std::max(mbpsTable, 
+			benchTokenizerMegabytesPerSecond(
+				ktokeNext, data, iterations, checksumTable));
+	}
+	printf("tokenizer[%s]: %zu bytes x %i x %i rounds\n", dataName, 
+	       data.size(), iterations, rounds);
+	printf("\tlegacy comparison chain: %10.2f MB/s\n", mbpsLegacy);
+	printf("\ttable-driven:            %10.2f MB/s (%.2fx)\n", mbpsTable, 
+	       mbpsTable / mbpsLegacy);
+	if(checksumLegacy != checksumTable)
+	{
+		fprintf(stderr, "ERROR: tokenizer token streams differ!\n");
+		return false;
+	}
+	return true;
+}
+/* The original per-case override lookup, kept as the baseline which 
+	kptuFirstOverride is measured against: every (virtual function, derived 
+	struct) case scans all of the derived struct's overrides & sorts the 
+	matches. */
+static vector<uint32_t> benchLegacyGetFunctionOverrides(
+	const KPtuDatabase& db, uint32_t virtualFunction, uint32_t derivedStruct)
+{
+	const KSymbol virtualFunctionId = 
+		db.virtualFunctions[virtualFunction].identifier;
+	vector<uint32_t> overrideFunctionList;
+	for(uint32_t o = db.derivedStructs[derivedStruct].firstFunctionOverride; 
+		o != KPTU_INVALID_INDEX; o = db.functionOverrides[o].nextInDerivedStruct)
+		if(db.functionOverrides[o].superFunctionIdentifier == virtualFunctionId)
+			overrideFunctionList.push_back(o);
+	kptuSortByIdentifier(db.functionOverrides, overrideFunctionList);
+	return overrideFunctionList;
+}
+/** Build a PTU with `derivedStructCount` derived structs & 
+ * `virtualFunctionCount` virtual functions.  Every derived struct overrides 
+ * every virtual function, except for every 8th one which overrides none. */
+static uint32_t benchBuildSyntheticPtu(KPtuDatabase& db, 
+                                       uint32_t derivedStructCount, 
+                                       uint32_t virtualFunctionCount)
+{
+	const PolymorphicTaggedUnionPureVirtualFunctionMetaData functionMeta = 
+		{ .qualifierTokens = {{KTokenType::IDENTIFIER, "void"}, 
+		                      {KTokenType::WHITESPACE, " "}}
+		, .params = 
+			{ { .identifier      = "bp"
+			  , .qualifierTokens = {{KTokenType::IDENTIFIER, "BenchPtu"}, 
+			                        {KTokenType::ASTERISK, "*"}, 
+			                        {KTokenType::WHITESPACE, " "}, 
+			                        {KTokenType::IDENTIFIER, "bp"}} } } };
+	const KPtuFunctionSignature signature = 
+		kptuPushFunctionSignature(db, functionMeta);
+	const uint32_t ptu = kptuFindOrInsertPtu(db, ksymbolIntern("BenchPtu"));
+	vector<KSymbol> virtualFunctionIds;
+	for(uint32_t v = 0; v < virtualFunctionCount; v++)
+	{
+		const string id = "benchFunction" + std::to_string(v);
+		virtualFunctionIds.push_back(ksymbolIntern(id));
+		kptuInsertVirtualFunction(db, ptu, virtualFunctionIds.back(), 
+		                          signature, false, false);
+	}
+	for(uint32_t d = 0; d < derivedStructCount; d++)
+	{
+		const string derivedId = "BenchDerived" + std::to_string(d);
+		const uint32_t derivedStruct = 
+			kptuInsertDerivedStruct(db, ptu, ksymbolIntern(derivedId), false);
+		if(d % 8 == 7)
+			continue;
+		for(uint32_t v = 0; v < virtualFunctionCount; v++)
+		{
+			const string id = 
+				"benchDerived" + std::to_string(d) + "Function" + 
+				std::to_string(v);
+			kptuInsertFunctionOverride(db, derivedStruct, ksymbolIntern(id), 
+			                           virtualFunctionIds[v], signature);
+		}
+	}
+	return ptu;
+}
+static bool benchRunOverrideIndex()
+{
+	const uint32_t derivedStructCount   = 1000;
+	const uint32_t virtualFunctionCount = 16;
+	const int rounds = 5;
+	KPtuDatabase db = {};
+	const uint32_t ptu = 
+		benchBuildSyntheticPtu(db, derivedStructCount, virtualFunctionCount);
+	const vector<uint32_t> derivedStructs = kptuSortedDerivedStructs(db, ptu);
+	const vector<uint32_t> virtualFunctions = 
+		kptuSortedVirtualFunctions(db, ptu);
+	double secondsLegacy   = std::numeric_limits<double>::max();
+	double secondsBuild    = std::numeric_limits<double>::max();
+	double secondsIndexed  = std::numeric_limits<double>::max();
+	double secondsGenerate = std::numeric_limits<double>::max();
+	uint64_t checksumLegacy  = 0;
+	uint64_t checksumIndexed = 0;
+	for(int r = 0; r < rounds; r++)
+	{
+		auto timeStart = chrono::high_resolution_clock::now();
+		checksumLegacy = 0;
+		for(const uint32_t v : virtualFunctions)
+			for(const uint32_t d : derivedStructs)
+				for(const uint32_t o : 
+					benchLegacyGetFunctionOverrides(db, v, d))
+					checksumLegacy = checksumLegacy*31 + o;
+		auto timeEnd = chrono::high_resolution_clock::now();
+		secondsLegacy = std::min(secondsLegacy, 
+			chrono::duration<double>(timeEnd - timeStart).count());
+		timeStart = chrono::high_resolution_clock::now();
+		kptuBuildOverrideIndex(db);
+		timeEnd = chrono::high_resolution_clock::now();
+		secondsBuild = std::min(secondsBuild, 
+			chrono::duration<double>(timeEnd - timeStart).count());
+		timeStart = chrono::high_resolution_clock::now();
+		checksumIndexed = 0;
+		for(const uint32_t v : virtualFunctions)
+			for(const uint32_t d : derivedStructs)
+				for(uint32_t o = kptuFirstOverride(db, d, v); 
+					o != KPTU_INVALID_INDEX; 
+					o = db.functionOverrides[o].nextOverridingSameFunction)
+					checksumIndexed = checksumIndexed*31 + o;
+		timeEnd = chrono::high_resolution_clock::now();
+		secondsIndexed = std::min(secondsIndexed, 
+			chrono::duration<double>(timeEnd - timeStart).count());
+		timeStart = chrono::high_resolution_clock::now();
+		kemitReset(g_emitter);
+		generatePolymorphicTaggedUnionDispatch(g_emitter, db, ptu);
+		timeEnd = chrono::high_resolution_clock::now();
+		secondsGenerate = std::min(secondsGenerate, 
+			chrono::duration<double>(timeEnd - timeStart).count());
+	}
+	printf("override lookup: %u derived structs x %u virtual functions x "
+	       "%i rounds\n", derivedStructCount, virtualFunctionCount, rounds);
+	printf("\tlegacy per-case scan:   %10.3f ms\n", secondsLegacy*1000);
+	printf("\tbuild override index:   %10.3f ms\n", secondsBuild*1000);
+	printf("\tindexed lookup:         %10.3f ms (%.2fx)\n", 
+	       secondsIndexed*1000, secondsLegacy / secondsIndexed);
+	printf("\tgenerate dispatch:      %10.3f ms (%zu bytes)\n", 
+	       secondsGenerate*1000, g_emitter.size);
+	kptuDatabaseFree(db);
+	if(checksumLegacy != checksumIndexed)
+	{
+		fprintf(stderr, "ERROR: override lookups differ!\n");
+		return false;
+	}
+	return true;
+}
+static int benchmarkMain(const vector<fs::path>& vecFsPathInputs)
+{
+	bool success =
+		benchRunTokenizer(benchGenerateSyntheticSource(16*1024*1024),
+		                  "synthetic");
+	success = benchRunOverrideIndex() && success;
+	if(!vecFsPathInputs.empty())
+	{
+		/* concatenate all the input files into one null-terminated stream */
+		string inputData;
+		for(const fs::path& fsPathInput : vecFsPathInputs)
+		{
+			for(const fs::directory_entry& fsDirEnt :
+				fs::recursive_directory_iterator(fsPathInput))
+			{
+				if(!fsDirEnt.is_regular_file())
+					continue;
+				const uintmax_t fileSize = fs::file_size(fsDirEnt.path());
+				char*const fileData =
+					readEntireFile(fsDirEnt.path().c_str(), fileSize);
+				if(!fileData)
+					continue;
+				/* the tokenizer would stop at embedded null-terminators */
+				inputData.append(fileData, strnlen(fileData, fileSize));
+				inputData.push_back('\n');
+				free(fileData);
+			}
+		}
+		success = benchRunTokenizer(inputData, "inputs") && success;
+	}
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,294 @@
+/* Persistent per-file parse cache.  The PTU facts extracted from each input
+	file only depend on the contents of that file, so we can store them on disk
+	& skip re-parsing files which have not changed since the last run.  A file
+	is considered unchanged without even opening it if its size & modification
+	time match the cache.  If only the modification time differs, the file is
+	read & its content hash is compared, which still saves the tokenizer pass.
+
+	The cache is a single binary file.  It is validated by a header & a trailing
+	checksum, and any cache which fails validation is simply ignored. */
+/* increment this whenever the parser or the serialized format changes! */
+static const uint32_t KCACHE_VERSION = 6;
+static const uint32_t KCACHE_MAGIC   = 0x4843504B;// "KPCH"
+static const char*const KCACHE_FILE_NAME = "kcpp_parse_cache.bin";
+struct ParseCacheEntry
+{
+	uintmax_t fileSize;
+	int64_t lastWriteTime;
+	uint64_t contentHash;
+	vector<PolymorphicTaggedUnionParseEvent> ptuEvents;
+	vector<string_view> kassets;
+};
+struct ParseCache
+{
+	map<fs::path::string_type, ParseCacheEntry> entries;
+	/* the StringTokens of the cached events (& the cached kassets) are views 
+		into the contents of the cache file, so it must remain loaded for as 
+		long as they are used */
+	char* fileData;
+};
+static uint64_t kcacheHash(const char* data, size_t size)
+{
+	/* multiply-xorshift over 8-byte words; this doesn't need to be
+		cryptographically secure, it only needs to detect edits */
+	const uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+	uint64_t hash = 0xCBF29CE484222325ull ^ (size * MULTIPLIER);
+	size_t i = 0;
+	for(; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * MULTIPLIER;
+		hash ^= hash >> 29;
+	}
+	for(; i < size; i++)
+	{
+		hash = (hash ^ static_cast<uint8_t>(data[i])) * MULTIPLIER;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+static int64_t kcacheLastWriteTime(const fs::directory_entry& fsDirEnt)
+{
+	return static_cast<int64_t>(
+		fsDirEnt.last_write_time().time_since_epoch().count());
+}
+/* --- serialization --- */
+static void kcacheWriteBytes(string& buffer, const void* data, size_t size)
+{
+	buffer.append(static_cast<const char*>(data), size);
+}
+template<class T>
+static void kcacheWrite(string& buffer, T value)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	kcacheWriteBytes(buffer, &value, sizeof(value));
+}
+template<class StringT>
+static void kcacheWriteString(string& buffer, const StringT& str)
+{
+	kcacheWrite(buffer, static_cast<uint32_t>(str.size()));
+	kcacheWriteBytes(buffer, str.data(),
+	                 str.size()*sizeof(typename StringT::value_type));
+}
+/* symbols are stored as their strings, since their values are only 
+	meaningful within a single run; KSYMBOL_INVALID is stored as "" */
+static void kcacheWriteSymbol(string& buffer, KSymbol symbol)
+{
+	kcacheWriteString(buffer, symbol == KSYMBOL_INVALID 
+		? string_view() : ksymbolString(symbol));
+}
+static void kcacheWriteStringTokens(string& buffer,
+                                    const vector<StringToken>& tokens)
+{
+	kcacheWrite(buffer, static_cast<uint32_t>(tokens.size()));
+	for(const StringToken& token : tokens)
+	{
+		kcacheWrite(buffer, token.type);
+		kcacheWriteString(buffer, token.str);
+	}
+}
+static void kcacheWriteEvent(string& buffer,
+                             const PolymorphicTaggedUnionParseEvent& event)
+{
+	kcacheWrite(buffer, event.type);
+	kcacheWriteSymbol(buffer, event.ptuIdentifier);
+	kcacheWriteSymbol(buffer, event.derivedStructIdentifier);
+	kcacheWriteSymbol(buffer, event.functionIdentifier);
+	kcacheWriteSymbol(buffer, event.superFunctionIdentifier);
+	kcacheWrite(buffer, event.jumpTableDispatch);
+	kcacheWrite(buffer, event.orderSensitive);
+	kcacheWrite(buffer, event.boxed);
+	kcacheWrite(buffer, event.packedTag);
+	kcacheWriteStringTokens(buffer, event.functionMetaData.qualifierTokens);
+	kcacheWrite(buffer,
+	            static_cast<uint32_t>(event.functionMetaData.params.size()));
+	for(const auto& param : event.functionMetaData.params)
+	{
+		kcacheWriteString(buffer, param.identifier);
+		kcacheWriteStringTokens(buffer, param.qualifierTokens);
+	}
+}
+struct KCacheReader
+{
+	const char* at;
+	const char* end;
+	/* once set, all subsequent reads fail */
+	bool failed;
+};
+static bool kcacheReadBytes(KCacheReader& reader, void* outData, size_t size)
+{
+	if(reader.failed || static_cast<size_t>(reader.end - reader.at) < size)
+	{
+		reader.failed = true;
+		return false;
+	}
+	memcpy(outData, reader.at, size);
+	reader.at += size;
+	return true;
+}
+template<class T>
+static T kcacheRead(KCacheReader& reader)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	T result = {};
+	kcacheReadBytes(reader, &result, sizeof(result));
+	return result;
+}
+template<class StringT>
+static void kcacheReadString(KCacheReader& reader, StringT& outString)
+{
+	const uint32_t size = kcacheRead<uint32_t>(reader);
+	const size_t byteCount = size*sizeof(typename StringT::value_type);
+	if(reader.failed || static_cast<size_t>(reader.end - reader.at) < byteCount)
+	{
+		reader.failed = true;
+		return;
+	}
+	outString.resize(size);
+	kcacheReadBytes(reader, outString.data(), byteCount);
+}
+static string_view kcacheReadStringView(KCacheReader& reader)
+{
+	const uint32_t size = kcacheRead<uint32_t>(reader);
+	if(reader.failed || static_cast<size_t>(reader.end - reader.at) < size)
+	{
+		reader.failed = true;
+		return {};
+	}
+	const string_view result(reader.at, size);
+	reader.at += size;
+	return result;
+}
+static KSymbol kcacheReadSymbol(KCacheReader& reader)
+{
+	const string_view str = kcacheReadStringView(reader);
+	return str.empty() ? KSYMBOL_INVALID : ksymbolIntern(str);
+}
+static void kcacheReadStringTokens(KCacheReader& reader,
+                                   vector<StringToken>& outTokens)
+{
+	const uint32_t tokenCount = kcacheRead<uint32_t>(reader);
+	for(uint32_t t = 0; t < tokenCount && !reader.failed; t++)
+	{
+		StringToken token;
+		token.type = kcacheRead<KTokenType>(reader);
+		token.str  = kcacheReadStringView(reader);
+		outTokens.push_back(std::move(token));
+	}
+}
+static void kcacheReadEvent(KCacheReader& reader,
+                            PolymorphicTaggedUnionParseEvent& outEvent)
+{
+	outEvent.type = kcacheRead<PolymorphicTaggedUnionParseEvent::Type>(reader);
+	outEvent.ptuIdentifier           = kcacheReadSymbol(reader);
+	outEvent.derivedStructIdentifier = kcacheReadSymbol(reader);
+	outEvent.functionIdentifier      = kcacheReadSymbol(reader);
+	outEvent.superFunctionIdentifier = kcacheReadSymbol(reader);
+	outEvent.jumpTableDispatch       = kcacheRead<bool>(reader);
+	outEvent.orderSensitive          = kcacheRead<bool>(reader);
+	outEvent.boxed                   = kcacheRead<bool>(reader);
+	outEvent.packedTag               = kcacheRead<bool>(reader);
+	kcacheReadStringTokens(reader, outEvent.functionMetaData.qualifierTokens);
+	const uint32_t paramCount = kcacheRead<uint32_t>(reader);
+	for(uint32_t p = 0; p < paramCount && !reader.failed; p++)
+	{
+		PolymorphicTaggedUnionPureVirtualFunctionMetaData::Parameter param;
+		param.identifier = kcacheReadStringView(reader);
+		kcacheReadStringTokens(reader, param.qualifierTokens);
+		outEvent.functionMetaData.params.push_back(std::move(param));
+	}
+}
+/** `outCache` is left empty if the cache file doesn't exist or is invalid */
+static void kcacheLoad(const fs::path& fsPathCache, ParseCache& outCache)
+{
+	map<fs::path::string_type, ParseCacheEntry>& result = outCache.entries;
+	std::error_code errorCode;
+	const uintmax_t cacheFileSize = fs::file_size(fsPathCache, errorCode);
+	if(errorCode)
+		return;
+	char*const cacheFileData =
+		readEntireFile(fsPathCache.c_str(), cacheFileSize);
+	if(!cacheFileData)
+		return;
+	KCacheReader reader =
+		{ .at     = cacheFileData
+		, .end    = cacheFileData + cacheFileSize
+		, .failed = false };
+	/* the last 8 bytes of the file are a hash of everything before them */
+	if(cacheFileSize < sizeof(uint64_t))
+		reader.failed = true;
+	else
+	{
+		reader.end -= sizeof(uint64_t);
+		uint64_t storedChecksum;
+		memcpy(&storedChecksum, reader.end, sizeof(storedChecksum));
+		if(storedChecksum !=
+			kcacheHash(cacheFileData, reader.end - cacheFileData))
+			reader.failed = true;
+	}
+	if(kcacheRead<uint32_t>(reader) != KCACHE_MAGIC ||
+		kcacheRead<uint32_t>(reader) != KCACHE_VERSION ||
+		kcacheRead<uint32_t>(reader) != sizeof(fs::path::value_type))
+		reader.failed = true;
+	const uint32_t entryCount = kcacheRead<uint32_t>(reader);
+	for(uint32_t e = 0; e < entryCount && !reader.failed; e++)
+	{
+		fs::path::string_type path;
+		kcacheReadString(reader, path);
+		ParseCacheEntry entry;
+		entry.fileSize      = kcacheRead<uintmax_t>(reader);
+		entry.lastWriteTime = kcacheRead<int64_t>(reader);
+		entry.contentHash   = kcacheRead<uint64_t>(reader);
+		const uint32_t eventCount = kcacheRead<uint32_t>(reader);
+		for(uint32_t v = 0; v < eventCount && !reader.failed; v++)
+		{
+			PolymorphicTaggedUnionParseEvent event;
+			kcacheReadEvent(reader, event);
+			entry.ptuEvents.push_back(std::move(event));
+		}
+		const uint32_t kassetCount = kcacheRead<uint32_t>(reader);
+		for(uint32_t k = 0; k < kassetCount && !reader.failed; k++)
+			entry.kassets.push_back(kcacheReadStringView(reader));
+		result.insert({std::move(path), std::move(entry)});
+	}
+	if(reader.failed || reader.at != reader.end)
+	{
+		if(g_verbose)
+			printf("ignoring invalid parse cache '%ws'\n", fsPathCache.c_str());
+		result.clear();
+		free(cacheFileData);
+		return;
+	}
+	outCache.fileData = cacheFileData;
+}
+static bool kcacheSave(const fs::path& fsPathCache,
+                       const vector<ParsedFile>& parsedFiles)
+{
+	string buffer;
+	kcacheWrite(buffer, KCACHE_MAGIC);
+	kcacheWrite(buffer, KCACHE_VERSION);
+	kcacheWrite(buffer, static_cast<uint32_t>(sizeof(fs::path::value_type)));
+	uint32_t entryCount = 0;
+	for(const ParsedFile& parsedFile : parsedFiles)
+		if(!parsedFile.readFailure)
+			entryCount++;
+	kcacheWrite(buffer, entryCount);
+	for(const ParsedFile& parsedFile : parsedFiles)
+	{
+		if(parsedFile.readFailure)
+			continue;
+		kcacheWriteString(buffer, parsedFile.path.native());
+		kcacheWrite(buffer, parsedFile.fileSize);
+		kcacheWrite(buffer, parsedFile.lastWriteTime);
+		kcacheWrite(buffer, parsedFile.contentHash);
+		kcacheWrite(buffer, static_cast<uint32_t>(parsedFile.ptuEvents.size()));
+		for(const PolymorphicTaggedUnionParseEvent& event : parsedFile.ptuEvents)
+			kcacheWriteEvent(buffer, event);
+		kcacheWrite(buffer, static_cast<uint32_t>(parsedFile.kassets.size()));
+		for(const string_view kasset : parsedFile.kassets)
+			kcacheWriteString(buffer, kasset);
+	}
+	kcacheWrite(buffer, kcacheHash(buffer.data(), buffer.size()));
+	return writeEntireFileIfChanged(fsPathCache, buffer);
+}
@@ -0,0 +1,345 @@
+/* The PTU database.  All PTU metadata lives in a few contiguous arrays of
+	plain records which refer to each other by index.  Lookups go through
+	open-addressing hash tables keyed on interned identifier symbols.
+	Everything (including the variable-length token & parameter lists) is
+	allocated from a single bump arena, so the entire database is released in
+	one step. */
+static const uint32_t KPTU_INVALID_INDEX = ~0u;
+struct KPtuParameter
+{
+	string_view identifier;
+	span<const StringToken> qualifierTokens;
+};
+struct KPtuFunctionSignature
+{
+	span<const StringToken> qualifierTokens;
+	span<const KPtuParameter> params;
+};
+struct KPtuVirtualFunction
+{
+	KSymbol identifier;
+	KPtuFunctionSignature signature;
+	uint32_t nextInPtu;
+	bool jumpTableDispatch;
+	bool orderSensitive;
+};
+struct KPtuFunctionOverride
+{
+	KSymbol identifier;
+	/* the PTU virtual function which this function overrides */
+	KSymbol superFunctionIdentifier;
+	KPtuFunctionSignature signature;
+	uint32_t nextInDerivedStruct;
+	/* the next override of the same derived struct & virtual function, in 
+		identifier order; only valid after kptuBuildOverrideIndex */
+	uint32_t nextOverridingSameFunction;
+};
+struct KPtuDerivedStruct
+{
+	KSymbol identifier;
+	uint32_t ptu;
+	uint32_t firstFunctionOverride;
+	uint32_t nextInPtu;
+	/* stored out of line; the PTU's union only contains a pointer to it */
+	bool boxed;
+};
+struct KPtu
+{
+	KSymbol identifier;
+	uint32_t firstVirtualFunction;
+	uint32_t firstDerivedStruct;
+	/* all of this PTU's virtual functions are dispatched via jump tables */
+	bool jumpTableDispatch;
+	/* the type tag overlaps the start of each variant of the union */
+	bool packedTag;
+};
+/* open-addressing (linear probing) hash table of 64-bit keys -> 32-bit
+	values; the value KPTU_INVALID_INDEX marks an empty slot */
+struct KPtuIndexTable
+{
+	struct Slot
+	{
+		uint64_t key;
+		uint32_t value;
+	};
+	KArenaArray<Slot> slots;
+	uint32_t count;
+};
+struct KPtuDatabase
+{
+	KArena arena;
+	KArenaArray<KPtu> ptus;
+	KArenaArray<KPtuDerivedStruct> derivedStructs;
+	KArenaArray<KPtuVirtualFunction> virtualFunctions;
+	KArenaArray<KPtuFunctionOverride> functionOverrides;
+	/* symbol -> ptus index */
+	KPtuIndexTable ptuIndices;
+	/* (ptu index, symbol) -> derivedStructs index */
+	KPtuIndexTable derivedStructIndices;
+	/* (ptu index, symbol) -> virtualFunctions index */
+	KPtuIndexTable virtualFunctionIndices;
+	/* (derived struct index, symbol) -> functionOverrides index */
+	KPtuIndexTable functionOverrideIndices;
+	/* (derived struct index, super function symbol) -> the first 
+		functionOverrides index of a nextOverridingSameFunction chain; built by 
+		kptuBuildOverrideIndex once everything has been merged */
+	KPtuIndexTable overrideChainIndices;
+};
+static KPtuDatabase g_ptuDatabase;
+static uint64_t kptuHash(uint64_t key)
+{
+	/* splitmix64 finalizer */
+	key ^= key >> 30;
+	key *= 0xBF58476D1CE4E5B9ull;
+	key ^= key >> 27;
+	key *= 0x94D049BB133111EBull;
+	key ^= key >> 31;
+	return key;
+}
+static uint64_t kptuKey(uint32_t scopeIndex, KSymbol symbol)
+{
+	return (static_cast<uint64_t>(scopeIndex) << 32) | symbol;
+}
+static void kptuIndexTableResize(KArena& arena, KPtuIndexTable& table,
+                                 uint32_t slotCount);
+/** @return the slot which contains `key`, or the empty slot where it would be
+ *          inserted */
+static KPtuIndexTable::Slot& kptuIndexTableSlot(KPtuIndexTable& table,
+                                                uint64_t key)
+{
+	const uint32_t mask = table.slots.count - 1;
+	for(uint32_t s = static_cast<uint32_t>(kptuHash(key)) & mask; ;
+		s = (s + 1) & mask)
+	{
+		KPtuIndexTable::Slot& slot = table.slots[s];
+		if(slot.value == KPTU_INVALID_INDEX || slot.key == key)
+			return slot;
+	}
+}
+static uint32_t kptuIndexTableFind(const KPtuIndexTable& table, uint64_t key)
+{
+	if(table.count == 0)
+		return KPTU_INVALID_INDEX;
+	return kptuIndexTableSlot(const_cast<KPtuIndexTable&>(table), key).value;
+}
+static void kptuIndexTableInsert(KArena& arena, KPtuIndexTable& table,
+                                 uint64_t key, uint32_t value)
+{
+	/* keep the load factor at or below 1/2 */
+	if(2*(table.count + 1) > table.slots.count)
+		kptuIndexTableResize(arena, table,
+		                     std::max(32u, table.slots.count*2));
+	KPtuIndexTable::Slot& slot = kptuIndexTableSlot(table, key);
+	assert(slot.value == KPTU_INVALID_INDEX);
+	slot = {.key = key, .value = value};
+	table.count++;
+}
+static void kptuIndexTableResize(KArena& arena, KPtuIndexTable& table,
+                                 uint32_t slotCount)
+{
+	const KPtuIndexTable::Slot*const oldSlots = table.slots.data;
+	const uint32_t oldSlotCount = table.slots.count;
+	table.slots = {};
+	karenaArrayResize(arena, table.slots, slotCount);
+	table.slots.count = slotCount;
+	for(uint32_t s = 0; s < slotCount; s++)
+		table.slots[s].value = KPTU_INVALID_INDEX;
+	for(uint32_t s = 0; s < oldSlotCount; s++)
+		if(oldSlots[s].value != KPTU_INVALID_INDEX)
+			kptuIndexTableSlot(table, oldSlots[s].key) = oldSlots[s];
+}
+/** @return KPTU_INVALID_INDEX if there is no PTU called `symbol` */
+static uint32_t kptuFindPtu(const KPtuDatabase& db, KSymbol symbol)
+{
+	return kptuIndexTableFind(db.ptuIndices, kptuKey(0, symbol));
+}
+static uint32_t kptuFindOrInsertPtu(KPtuDatabase& db, KSymbol symbol)
+{
+	const uint32_t ptuIndex =
+		kptuIndexTableFind(db.ptuIndices, kptuKey(0, symbol));
+	if(ptuIndex != KPTU_INVALID_INDEX)
+		return ptuIndex;
+	const uint32_t result = karenaArrayPush(db.arena, db.ptus,
+		{ .identifier           = symbol
+		, .firstVirtualFunction = KPTU_INVALID_INDEX
+		, .firstDerivedStruct   = KPTU_INVALID_INDEX
+		, .jumpTableDispatch    = false
+		, .packedTag            = false });
+	kptuIndexTableInsert(db.arena, db.ptuIndices, kptuKey(0, symbol), result);
+	return result;
+}
+static uint32_t kptuFindDerivedStruct(const KPtuDatabase& db, uint32_t ptu,
+                                      KSymbol identifier)
+{
+	return kptuIndexTableFind(db.derivedStructIndices,
+	                          kptuKey(ptu, identifier));
+}
+/** `identifier` must not already be a derived struct of `ptu` */
+static uint32_t kptuInsertDerivedStruct(KPtuDatabase& db, uint32_t ptu,
+                                        KSymbol identifier, bool boxed)
+{
+	const uint32_t result = karenaArrayPush(db.arena, db.derivedStructs,
+		{ .identifier            = identifier
+		, .ptu                   = ptu
+		, .firstFunctionOverride = KPTU_INVALID_INDEX
+		, .nextInPtu             = db.ptus[ptu].firstDerivedStruct
+		, .boxed                 = boxed });
+	db.ptus[ptu].firstDerivedStruct = result;
+	kptuIndexTableInsert(db.arena, db.derivedStructIndices,
+	                     kptuKey(ptu, identifier), result);
+	return result;
+}
+static uint32_t kptuFindVirtualFunction(const KPtuDatabase& db, uint32_t ptu,
+                                        KSymbol identifier)
+{
+	return kptuIndexTableFind(db.virtualFunctionIndices,
+	                          kptuKey(ptu, identifier));
+}
+/** `identifier` must not already be a virtual function of `ptu` */
+static uint32_t kptuInsertVirtualFunction(
+	KPtuDatabase& db, uint32_t ptu, KSymbol identifier,
+	const KPtuFunctionSignature& signature, bool jumpTableDispatch, 
+	bool orderSensitive)
+{
+	const uint32_t result = karenaArrayPush(db.arena, db.virtualFunctions,
+		{ .identifier        = identifier
+		, .signature         = signature
+		, .nextInPtu         = db.ptus[ptu].firstVirtualFunction
+		, .jumpTableDispatch = jumpTableDispatch
+		, .orderSensitive    = orderSensitive });
+	db.ptus[ptu].firstVirtualFunction = result;
+	kptuIndexTableInsert(db.arena, db.virtualFunctionIndices,
+	                     kptuKey(ptu, identifier), result);
+	return result;
+}
+static uint32_t kptuFindFunctionOverride(const KPtuDatabase& db,
+                                         uint32_t derivedStruct,
+                                         KSymbol identifier)
+{
+	return kptuIndexTableFind(db.functionOverrideIndices,
+	                          kptuKey(derivedStruct, identifier));
+}
+/** `identifier` must not already be an override of `derivedStruct` */
+static uint32_t kptuInsertFunctionOverride(
+	KPtuDatabase& db, uint32_t derivedStruct, KSymbol identifier,
+	KSymbol superFunctionIdentifier, const KPtuFunctionSignature& signature)
+{
+	KPtuDerivedStruct& derived = db.derivedStructs[derivedStruct];
+	const uint32_t result = karenaArrayPush(db.arena, db.functionOverrides,
+		{ .identifier                 = identifier
+		, .superFunctionIdentifier    = superFunctionIdentifier
+		, .signature                  = signature
+		, .nextInDerivedStruct        = derived.firstFunctionOverride
+		, .nextOverridingSameFunction = KPTU_INVALID_INDEX });
+	derived.firstFunctionOverride = result;
+	kptuIndexTableInsert(db.arena, db.functionOverrideIndices,
+	                     kptuKey(derivedStruct, identifier), result);
+	return result;
+}
+/** Copy a parsed function signature into the database's arena. */
+static KPtuFunctionSignature kptuPushFunctionSignature(
+	KPtuDatabase& db,
+	const PolymorphicTaggedUnionPureVirtualFunctionMetaData& functionMeta)
+{
+	vector<KPtuParameter> params;
+	params.reserve(functionMeta.params.size());
+	for(const auto& param : functionMeta.params)
+		params.push_back(
+			{ .identifier      = param.identifier
+			, .qualifierTokens = karenaPushArray(
+				db.arena, param.qualifierTokens.data(),
+				param.qualifierTokens.size()) });
+	return
+		{ .qualifierTokens = karenaPushArray(
+			db.arena, functionMeta.qualifierTokens.data(),
+			functionMeta.qualifierTokens.size())
+		, .params = karenaPushArray(db.arena, params.data(), params.size()) };
+}
+/** Generated code lists everything in identifier order, so that it does not
+ * depend on the order in which the facts were merged. */
+template<class Record>
+static void kptuSortByIdentifier(const KArenaArray<Record>& records,
+                                 vector<uint32_t>& indices)
+{
+	std::sort(indices.begin(), indices.end(),
+		[&records](uint32_t a, uint32_t b)
+		{
+			return ksymbolString(records[a].identifier) <
+			       ksymbolString(records[b].identifier);
+		});
+}
+static vector<uint32_t> kptuSortedDerivedStructs(const KPtuDatabase& db,
+                                                 uint32_t ptu)
+{
+	vector<uint32_t> result;
+	for(uint32_t d = db.ptus[ptu].firstDerivedStruct; d != KPTU_INVALID_INDEX;
+		d = db.derivedStructs[d].nextInPtu)
+		result.push_back(d);
+	kptuSortByIdentifier(db.derivedStructs, result);
+	return result;
+}
+static vector<uint32_t> kptuSortedVirtualFunctions(const KPtuDatabase& db,
+                                                   uint32_t ptu)
+{
+	vector<uint32_t> result;
+	for(uint32_t v = db.ptus[ptu].firstVirtualFunction;
+		v != KPTU_INVALID_INDEX; v = db.virtualFunctions[v].nextInPtu)
+		result.push_back(v);
+	kptuSortByIdentifier(db.virtualFunctions, result);
+	return result;
+}
+/** Index every function override by the derived struct & virtual function 
+ * which it overrides, so that the dispatch generator can look up the overrides 
+ * of each case directly instead of scanning the derived struct's overrides.  
+ * Must be called again after more function overrides are inserted. */
+static void kptuBuildOverrideIndex(KPtuDatabase& db)
+{
+	db.overrideChainIndices = {};
+	uint32_t slotCount = 32;
+	while(slotCount < 2*db.functionOverrides.count)
+		slotCount *= 2;
+	kptuIndexTableResize(db.arena, db.overrideChainIndices, slotCount);
+	for(uint32_t d = 0; d < db.derivedStructs.count; d++)
+		for(uint32_t o = db.derivedStructs[d].firstFunctionOverride; 
+			o != KPTU_INVALID_INDEX; 
+			o = db.functionOverrides[o].nextInDerivedStruct)
+		{
+			KPtuFunctionOverride& functionOverride = db.functionOverrides[o];
+			functionOverride.nextOverridingSameFunction = KPTU_INVALID_INDEX;
+			const uint64_t key = 
+				kptuKey(d, functionOverride.superFunctionIdentifier);
+			KPtuIndexTable::Slot& slot = 
+				kptuIndexTableSlot(db.overrideChainIndices, key);
+			if(slot.value == KPTU_INVALID_INDEX)
+			{
+				slot = {.key = key, .value = o};
+				db.overrideChainIndices.count++;
+				continue;
+			}
+			/* a virtual function is rarely overridden more than once by the 
+				same derived struct, so identifier strings are only compared 
+				to keep such chains sorted */
+			const string_view id = ksymbolString(functionOverride.identifier);
+			uint32_t* link = &slot.value;
+			while(*link != KPTU_INVALID_INDEX && 
+				ksymbolString(db.functionOverrides[*link].identifier) < id)
+				link = &db.functionOverrides[*link].nextOverridingSameFunction;
+			functionOverride.nextOverridingSameFunction = *link;
+			*link = o;
+		}
+}
+/** @return the first override of `virtualFunction` by `derivedStruct` (the 
+ *          rest follow via nextOverridingSameFunction in identifier order), 
+ *          or KPTU_INVALID_INDEX if it is not overridden */
+static uint32_t kptuFirstOverride(const KPtuDatabase& db, 
+                                  uint32_t derivedStruct, 
+                                  uint32_t virtualFunction)
+{
+	return kptuIndexTableFind(db.overrideChainIndices, 
+		kptuKey(derivedStruct, db.virtualFunctions[virtualFunction].identifier));
+}
+static void kptuDatabaseFree(KPtuDatabase& db)
+{
+	karenaFree(db.arena);
+	db = {};
+}
@@ -0,0 +1,61 @@
+/* A growable output buffer for generated code.  The generators append 
+	identifiers & code fragments straight into it, so no temporary strings are 
+	built for each line, and the same buffer is reused for every generated 
+	file so its storage only ever grows to the size of the largest one. */
+struct KEmitter
+{
+	char* data;
+	size_t size;
+	size_t capacity;
+};
+static KEmitter g_emitter;
+static char* kemitReserve(KEmitter& emitter, size_t byteCount)
+{
+	if(emitter.size + byteCount > emitter.capacity)
+	{
+		const size_t capacity = 
+			std::max(emitter.size + byteCount, 
+			         std::max<size_t>(4096, emitter.capacity*2));
+		char*const data = static_cast<char*>(realloc(emitter.data, capacity));
+		if(!data)
+		{
+			fprintf(stderr, "Failed to alloc %zu bytes!\n", capacity);
+			exit(EXIT_FAILURE);
+		}
+		emitter.data     = data;
+		emitter.capacity = capacity;
+	}
+	char*const result = emitter.data + emitter.size;
+	emitter.size += byteCount;
+	return result;
+}
+static void kemitReset(KEmitter& emitter)
+{
+	emitter.size = 0;
+}
+static void kemit(KEmitter& emitter, string_view str)
+{
+	memcpy(kemitReserve(emitter, str.size()), str.data(), str.size());
+}
+static void kemitUpperCase(KEmitter& emitter, string_view str)
+{
+	char*const out = kemitReserve(emitter, str.size());
+	for(size_t c = 0; c < str.size(); c++)
+		out[c] = static_cast<char>(toupper(static_cast<uint8_t>(str[c])));
+}
+/** Emit `str` with only its first character converted to upper case. */
+static void kemitTitleCase(KEmitter& emitter, string_view str)
+{
+	char*const out = kemitReserve(emitter, str.size());
+	memcpy(out, str.data(), str.size());
+	if(!str.empty())
+		out[0] = static_cast<char>(toupper(static_cast<uint8_t>(str[0])));
+}
+/** Emit `str` with only its first character converted to lower case. */
+static void kemitCamelCase(KEmitter& emitter, string_view str)
+{
+	char*const out = kemitReserve(emitter, str.size());
+	memcpy(out, str.data(), str.size());
+	if(!str.empty())
+		out[0] = static_cast<char>(tolower(static_cast<uint8_t>(str[0])));
+}
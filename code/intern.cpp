@@ -0,0 +1,130 @@
+/* The global symbol table.  Every identifier which kcpp stores (PTU names,
+	derived struct names & function names) is interned into a dense 32-bit
+	symbol once, when it is parsed, so that the rest of the program can compare
+	& hash identifiers as integers.  Files are parsed concurrently, so the table
+	is split into shards which are each guarded by their own mutex; threads only
+	contend when they intern identifiers which hash to the same shard.
+
+	Symbol values depend on the order in which threads intern identifiers, so
+	they must never affect the generated code.  Anything which is emitted in a
+	particular order is sorted by the symbol's string instead. */
+#include <mutex>
+using KSymbol = uint32_t;
+static const KSymbol KSYMBOL_INVALID = ~0u;
+struct KSymbolTable
+{
+	static const uint32_t SHARD_COUNT = 16;
+	/* symbol strings are stored in fixed-size chunks which are never moved,
+		so a symbol's string can be read without taking any locks */
+	static const uint32_t CHUNK_SIZE  = 4096;
+	static const uint32_t CHUNK_COUNT = 4096;
+	struct Shard
+	{
+		std::mutex mutex;
+		KArena arena;
+		/* open-addressing table of symbols; KSYMBOL_INVALID marks an empty
+			slot */
+		KArenaArray<KSymbol> slots;
+		uint32_t count;
+	};
+	Shard shards[SHARD_COUNT];
+	std::atomic<string_view*> chunks[CHUNK_COUNT];
+	std::atomic<uint32_t> count;
+	std::mutex chunkMutex;
+};
+static KSymbolTable g_symbols;
+static uint64_t ksymbolHash(string_view str)
+{
+	/* FNV-1a; identifiers are short */
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for(const char c : str)
+		hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001B3ull;
+	return hash;
+}
+static string_view ksymbolString(KSymbol symbol)
+{
+	assert(symbol < g_symbols.count.load(std::memory_order_relaxed));
+	const string_view*const chunk =
+		g_symbols.chunks[symbol / KSymbolTable::CHUNK_SIZE].load(
+			std::memory_order_acquire);
+	return chunk[symbol % KSymbolTable::CHUNK_SIZE];
+}
+static string_view* ksymbolStorage(KSymbol symbol)
+{
+	const uint32_t c = symbol / KSymbolTable::CHUNK_SIZE;
+	if(c >= KSymbolTable::CHUNK_COUNT)
+	{
+		fprintf(stderr, "Too many unique identifiers!\n");
+		exit(EXIT_FAILURE);
+	}
+	string_view* chunk = g_symbols.chunks[c].load(std::memory_order_acquire);
+	if(!chunk)
+	{
+		std::lock_guard<std::mutex> lock(g_symbols.chunkMutex);
+		chunk = g_symbols.chunks[c].load(std::memory_order_acquire);
+		if(!chunk)
+		{
+			chunk = static_cast<string_view*>(
+				calloc(KSymbolTable::CHUNK_SIZE, sizeof(string_view)));
+			if(!chunk)
+			{
+				fprintf(stderr, "Failed to alloc symbol chunk!\n");
+				exit(EXIT_FAILURE);
+			}
+			g_symbols.chunks[c].store(chunk, std::memory_order_release);
+		}
+	}
+	return &chunk[symbol % KSymbolTable::CHUNK_SIZE];
+}
+/** @return the slot of `shard` which contains `str`, or the empty slot where
+ *          it would be inserted.  The shard's mutex must be held. */
+static KSymbol& ksymbolSlot(KSymbolTable::Shard& shard, string_view str,
+                            uint64_t hash)
+{
+	const uint32_t mask = shard.slots.count - 1;
+	for(uint32_t s = static_cast<uint32_t>(hash) & mask; ; s = (s + 1) & mask)
+	{
+		KSymbol& slot = shard.slots[s];
+		if(slot == KSYMBOL_INVALID || ksymbolString(slot) == str)
+			return slot;
+	}
+}
+static KSymbolTable::Shard& ksymbolShard(uint64_t hash)
+{
+	static_assert(KSymbolTable::SHARD_COUNT == 16);
+	return g_symbols.shards[hash >> 60];
+}
+static KSymbol ksymbolIntern(string_view str)
+{
+	const uint64_t hash = ksymbolHash(str);
+	KSymbolTable::Shard& shard = ksymbolShard(hash);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	/* keep the load factor at or below 1/2 */
+	if(2*(shard.count + 1) > shard.slots.count)
+	{
+		const KArenaArray<KSymbol> oldSlots = shard.slots;
+		const uint32_t slotCount = std::max(64u, oldSlots.count*2);
+		shard.slots = {};
+		karenaArrayResize(shard.arena, shard.slots, slotCount);
+		shard.slots.count = slotCount;
+		for(uint32_t s = 0; s < slotCount; s++)
+			shard.slots[s] = KSYMBOL_INVALID;
+		for(uint32_t s = 0; s < oldSlots.count; s++)
+		{
+			const KSymbol symbol = oldSlots[s];
+			if(symbol != KSYMBOL_INVALID)
+			{
+				const string_view symbolStr = ksymbolString(symbol);
+				ksymbolSlot(shard, symbolStr, ksymbolHash(symbolStr)) = symbol;
+			}
+		}
+	}
+	KSymbol& slot = ksymbolSlot(shard, str, hash);
+	if(slot == KSYMBOL_INVALID)
+	{
+		slot = g_symbols.count.fetch_add(1, std::memory_order_relaxed);
+		*ksymbolStorage(slot) = karenaPushString(shard.arena, str);
+		shard.count++;
+	}
+	return slot;
+}
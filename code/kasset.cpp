@@ -0,0 +1,323 @@
+/* The KASSET registry.  Every `KASSET("path")` found in the input files
+	registers an asset path; the registry is rebuilt from the parsed files after
+	each parse, deduplicating the paths with a hash set, & is then generated
+	into `gen_kassets.h`.
+
+	`gen_kassets.h` also contains a minimal perfect hash of the registered
+	paths, so that looking up an asset by its path at runtime costs a single
+	string hash, two table reads & one full string compare, regardless of how
+	many assets are registered. */
+static const char*const KASSET_GENERATED_FILE_NAME = "gen_kassets.h";
+static const uint32_t KASSET_INVALID_INDEX = ~0u;
+/* the average # of assets which share a perfect hash bucket */
+static const uint32_t KASSET_PERFECT_HASH_BUCKET_SIZE = 4;
+/* if a bucket can't be placed with this many displacements, the perfect hash
+	is rebuilt with the next seed */
+static const uint32_t KASSET_PERFECT_HASH_MAX_DISPLACEMENT = 1u << 22;
+enum class KAssetFileType : uint8_t
+	{ PNG
+	, WAV
+	, OGG
+	, FLIPBOOK_META
+	, UNKNOWN
+	, ENUM_COUNT };
+static const char*const g_kassetFileTypeNames[] =
+	{ "PNG", "WAV", "OGG", "FLIPBOOK_META", "UNKNOWN" };
+static_assert(sizeof(g_kassetFileTypeNames) / sizeof(g_kassetFileTypeNames[0])
+	== static_cast<size_t>(KAssetFileType::ENUM_COUNT));
+struct KAssetRegistry
+{
+	KArena arena;
+	/* decoded asset paths, in order of first appearance until the registry is 
+		sorted */
+	vector<string_view> paths;
+	/* open-addressing hash set of indices into `paths`; KASSET_INVALID_INDEX
+		marks an empty slot */
+	vector<uint32_t> slots;
+};
+static KAssetRegistry g_kassetRegistry;
+static bool kassetEndsWith(string_view str, string_view suffix)
+{
+	return str.size() >= suffix.size() &&
+		str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+static KAssetFileType kassetFileType(string_view path)
+{
+	if(kassetEndsWith(path, ".png"))
+		return KAssetFileType::PNG;
+	if(kassetEndsWith(path, ".wav"))
+		return KAssetFileType::WAV;
+	if(kassetEndsWith(path, ".ogg"))
+		return KAssetFileType::OGG;
+	if(kassetEndsWith(path, ".fbm"))
+		return KAssetFileType::FLIPBOOK_META;
+	return KAssetFileType::UNKNOWN;
+}
+/** Decode the escape sequences in the contents of a string literal, so that
+ * the path is hashed exactly the same way as the string the program sees.
+ * @return false if the literal contains a null character or an escape
+ *         sequence which kcpp doesn't support (universal character names) */
+static bool kassetDecodeLiteral(string_view literal, string& outPath)
+{
+	outPath.clear();
+	for(size_t c = 0; c < literal.size(); c++)
+	{
+		if(literal[c] != '\\')
+		{
+			outPath.push_back(literal[c]);
+			continue;
+		}
+		if(++c >= literal.size())
+			return false;
+		unsigned value = 0;
+		switch(literal[c])
+		{
+			case '\'': case '"': case '?': case '\\':
+				value = static_cast<uint8_t>(literal[c]); break;
+			case 'a': value = '\a'; break;
+			case 'b': value = '\b'; break;
+			case 'f': value = '\f'; break;
+			case 'n': value = '\n'; break;
+			case 'r': value = '\r'; break;
+			case 't': value = '\t'; break;
+			case 'v': value = '\v'; break;
+			case 'x':
+			{
+				size_t digitCount = 0;
+				for(; c + 1 < literal.size() && isxdigit(
+						static_cast<uint8_t>(literal[c + 1])); digitCount++)
+				{
+					const char digit = literal[++c];
+					value = value*16 + (isdigit(static_cast<uint8_t>(digit))
+						? digit - '0' : (tolower(digit) - 'a' + 10));
+					if(value > 0xFF)
+						return false;
+				}
+				if(digitCount == 0)
+					return false;
+			}break;
+			default:
+			{
+				/* octal escape sequences have at most 3 digits */
+				size_t digitCount = 0;
+				for(c--; digitCount < 3 && c + 1 < literal.size() &&
+					literal[c + 1] >= '0' && literal[c + 1] <= '7';
+					digitCount++)
+				{
+					value = value*8 + (literal[++c] - '0');
+				}
+				if(digitCount == 0 || value > 0xFF)
+					return false;
+			}break;
+		}
+		outPath.push_back(static_cast<char>(value));
+	}
+	return outPath.find('\0') == string::npos;
+}
+/** @return the slot of `registry` which contains `path`, or the empty slot
+ *          where it would be inserted */
+static uint32_t& kassetRegistrySlot(KAssetRegistry& registry, string_view path)
+{
+	const size_t mask = registry.slots.size() - 1;
+	for(size_t s = ksymbolHash(path) & mask; ; s = (s + 1) & mask)
+	{
+		uint32_t& slot = registry.slots[s];
+		if(slot == KASSET_INVALID_INDEX || registry.paths[slot] == path)
+			return slot;
+	}
+}
+/** @return the index of `path` in the registry */
+static uint32_t kassetRegistryInsert(KAssetRegistry& registry, string_view path)
+{
+	/* keep the load factor at or below 1/2 */
+	if(2*(registry.paths.size() + 1) > registry.slots.size())
+	{
+		const size_t slotCount = std::max<size_t>(64, registry.slots.size()*2);
+		registry.slots.assign(slotCount, KASSET_INVALID_INDEX);
+		for(uint32_t a = 0; a < registry.paths.size(); a++)
+			kassetRegistrySlot(registry, registry.paths[a]) = a;
+	}
+	uint32_t& slot = kassetRegistrySlot(registry, path);
+	if(slot == KASSET_INVALID_INDEX)
+	{
+		slot = static_cast<uint32_t>(registry.paths.size());
+		registry.paths.push_back(karenaPushString(registry.arena, path));
+	}
+	return slot;
+}
+/** Implicitly register a `png` asset with the same file name prefix in the same
+ * directory as each flipbook meta asset (for now...) */
+static void kassetRegistryAddImpliedAssets(KAssetRegistry& registry)
+{
+	const size_t explicitAssetCount = registry.paths.size();
+	string impliedPngPath;
+	for(size_t a = 0; a < explicitAssetCount; a++)
+	{
+		const string_view path = registry.paths[a];
+		if(kassetFileType(path) != KAssetFileType::FLIPBOOK_META)
+			continue;
+		impliedPngPath.assign(path.substr(0, path.size() - 4));
+		impliedPngPath.append(".png");
+		kassetRegistryInsert(registry, impliedPngPath);
+	}
+}
+/** Order the assets by file type, & by path within each type, so that the 
+ * assets of each type occupy a contiguous range of KASSET indices which can be 
+ * loaded as a batch.  This also makes the indices independent of the order in 
+ * which the input files are merged. */
+static void kassetRegistrySort(KAssetRegistry& registry)
+{
+	std::sort(registry.paths.begin(), registry.paths.end(), 
+		[](string_view a, string_view b)
+		{
+			const KAssetFileType fileTypeA = kassetFileType(a);
+			const KAssetFileType fileTypeB = kassetFileType(b);
+			if(fileTypeA != fileTypeB)
+				return fileTypeA < fileTypeB;
+			return a < b;
+		});
+	registry.slots.assign(registry.slots.size(), KASSET_INVALID_INDEX);
+	for(uint32_t a = 0; a < registry.paths.size(); a++)
+		kassetRegistrySlot(registry, registry.paths[a]) = a;
+}
+static void kassetRegistryFree(KAssetRegistry& registry)
+{
+	karenaFree(registry.arena);
+	registry.paths.clear();
+	registry.slots.clear();
+}
+/* --- minimal perfect hash ---
+	Hash & displace: the assets are distributed into buckets by their hash, &
+	the buckets are then placed into the slot table from largest to smallest.
+	For each bucket we search for the first displacement which moves all of its
+	assets into free slots.  The table has exactly one slot per asset. */
+static uint64_t kassetHash(string_view str, uint64_t seed)
+{
+	/* FNV-1a, followed by a finalizer which mixes the last characters into
+		the upper bits which select the bucket */
+	uint64_t hash = 0xCBF29CE484222325ull ^ seed;
+	for(const char c : str)
+		hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001B3ull;
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDull;
+	hash ^= hash >> 33;
+	return hash;
+}
+static uint32_t kassetHashBucket(uint64_t hash, uint32_t bucketCount)
+{
+	return static_cast<uint32_t>((hash >> 32) % bucketCount);
+}
+static uint32_t kassetHashSlot(uint64_t hash, uint32_t displacement,
+                               uint32_t slotCount)
+{
+	uint64_t x = hash ^ (displacement * 0x9E3779B97F4A7C15ull);
+	x ^= x >> 32;
+	x *= 0xD6E8FEB86659FD93ull;
+	x ^= x >> 32;
+	return static_cast<uint32_t>(x % slotCount);
+}
+/* the generated equivalents of the functions above; they must always produce
+	the same results.  They are constexpr so that string literals can be
+	resolved to their asset at compile time. */
+static const char*const KASSET_HASH_DEFINITION =
+	"constexpr uint64_t kassetHash(const char* cStr, uint64_t seed)\n"
+	"{\n"
+	"\tuint64_t hash = 0xCBF29CE484222325ull ^ seed;\n"
+	"\tfor(; *cStr; cStr++)\n"
+	"\t\thash = (hash ^ static_cast<unsigned char>(*cStr)) * "
+		"0x100000001B3ull;\n"
+	"\thash ^= hash >> 33;\n"
+	"\thash *= 0xFF51AFD7ED558CCDull;\n"
+	"\thash ^= hash >> 33;\n"
+	"\treturn hash;\n"
+	"}\n"
+	"constexpr uint32_t kassetHashBucket(uint64_t hash, uint32_t bucketCount)\n"
+	"{\n"
+	"\treturn static_cast<uint32_t>((hash >> 32) % bucketCount);\n"
+	"}\n"
+	"constexpr uint32_t kassetHashSlot(uint64_t hash, uint32_t displacement, \n"
+	"                                  uint32_t slotCount)\n"
+	"{\n"
+	"\tuint64_t x = hash ^ (displacement * 0x9E3779B97F4A7C15ull);\n"
+	"\tx ^= x >> 32;\n"
+	"\tx *= 0xD6E8FEB86659FD93ull;\n"
+	"\tx ^= x >> 32;\n"
+	"\treturn static_cast<uint32_t>(x % slotCount);\n"
+	"}\n";
+struct KAssetPerfectHash
+{
+	uint64_t seed;
+	/* one per bucket */
+	vector<uint32_t> displacements;
+	/* the index of the asset stored in each slot */
+	vector<uint32_t> slotAssets;
+};
+static KAssetPerfectHash 
+	kassetBuildPerfectHash(const vector<string_view>& paths)
+{
+	const uint32_t assetCount = static_cast<uint32_t>(paths.size());
+	const uint32_t bucketCount = std::max(1u,
+		(assetCount + KASSET_PERFECT_HASH_BUCKET_SIZE - 1) /
+			KASSET_PERFECT_HASH_BUCKET_SIZE);
+	KAssetPerfectHash result = {};
+	vector<uint64_t> hashes(assetCount);
+	vector<vector<uint32_t>> buckets(bucketCount);
+	vector<uint32_t> bucketOrder(bucketCount);
+	vector<uint32_t> bucketSlots;
+	for(;; result.seed++)
+	{
+		for(vector<uint32_t>& bucket : buckets)
+			bucket.clear();
+		for(uint32_t a = 0; a < assetCount; a++)
+		{
+			hashes[a] = kassetHash(paths[a], result.seed);
+			buckets[kassetHashBucket(hashes[a], bucketCount)].push_back(a);
+		}
+		for(uint32_t b = 0; b < bucketCount; b++)
+			bucketOrder[b] = b;
+		std::stable_sort(bucketOrder.begin(), bucketOrder.end(),
+			[&buckets](uint32_t a, uint32_t b)
+			{ return buckets[a].size() > buckets[b].size(); });
+		result.displacements.assign(bucketCount, 0);
+		result.slotAssets.assign(assetCount, KASSET_INVALID_INDEX);
+		bool success = true;
+		for(const uint32_t b : bucketOrder)
+		{
+			const vector<uint32_t>& bucket = buckets[b];
+			if(bucket.empty())
+				break;
+			uint32_t displacement = 0;
+			for(; displacement < KASSET_PERFECT_HASH_MAX_DISPLACEMENT;
+				displacement++)
+			{
+				/* claim the slots of the bucket's assets one at a time, &
+					release them again if any of them collide */
+				bucketSlots.clear();
+				for(const uint32_t a : bucket)
+				{
+					const uint32_t s =
+						kassetHashSlot(hashes[a], displacement, assetCount);
+					if(result.slotAssets[s] != KASSET_INVALID_INDEX)
+						break;
+					result.slotAssets[s] = a;
+					bucketSlots.push_back(s);
+				}
+				if(bucketSlots.size() == bucket.size())
+					break;
+				for(const uint32_t s : bucketSlots)
+					result.slotAssets[s] = KASSET_INVALID_INDEX;
+			}
+			if(displacement == KASSET_PERFECT_HASH_MAX_DISPLACEMENT)
+			{
+				success = false;
+				break;
+			}
+			result.displacements[b] = displacement;
+		}
+		if(success)
+			return result;
+		if(g_verbose)
+			printf("KASSET perfect hash seed %llu failed; retrying\n",
+			       static_cast<unsigned long long>(result.seed));
+	}
+}
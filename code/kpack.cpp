@@ -0,0 +1,334 @@
+/* The KASSET pack (`kcpp ... --kasset-pack asset_directory`).  The bytes of
+	every registered asset are stored in a single file next to gen_kassets.h,
+	each one aligned for direct use, so that a program can map the pack once
+	instead of opening thousands of small files.  gen_kassets.h describes where
+	each asset is stored, indexed by KASSET index.
+
+	The pack is rebuilt incrementally using a manifest of the size &
+	modification time of each asset it contains.  The unchanged assets are
+	copied out of the previous pack, & only the changed assets are read from
+	their own files.  A new pack is always written to a temporary file which
+	then replaces the previous pack, so that a program which has the pack
+	mapped never sees its contents change, & an interrupted run never leaves
+	a torn pack behind. */
+static const uint32_t KPACK_MAGIC            = 0x4B41504B;// "KPAK"
+static const uint32_t KPACK_VERSION          = 1;
+static const uint32_t KPACK_MANIFEST_MAGIC   = 0x4D4B504B;// "KPKM"
+static const uint32_t KPACK_MANIFEST_VERSION = 1;
+static const uint64_t KPACK_ALIGNMENT        = 64;
+static const char*const KPACK_FILE_NAME = "gen_kassets.pack";
+static const char*const KPACK_MANIFEST_FILE_NAME =
+	"kcpp_kasset_pack_manifest.bin";
+/* the pack begins with this header, followed by the assets */
+struct KPackHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	/* identifies the gen_kassets.h which describes this pack */
+	uint64_t layoutHash;
+	uint64_t assetCount;
+	uint64_t byteCount;
+};
+struct KPackAsset
+{
+	uintmax_t fileSize;
+	int64_t lastWriteTime;
+	uint64_t offset;
+};
+struct KPackLayout
+{
+	/* indexed by KASSET index */
+	vector<KPackAsset> assets;
+	uint64_t layoutHash;
+	uint64_t byteCount;
+};
+struct KPackManifest
+{
+	uint64_t layoutHash;
+	map<string, KPackAsset, std::less<>> assets;
+};
+static uint64_t kpackAlign(uint64_t offset)
+{
+	return (offset + KPACK_ALIGNMENT - 1) & ~(KPACK_ALIGNMENT - 1);
+}
+static FILE* kpackOpenFile(const fs::path& fsPath)
+{
+#if _MSC_VER
+	return _wfopen(fsPath.c_str(), L"wb");
+#else
+	return fopen(fsPath.c_str(), "wb");
+#endif
+}
+/** Determine where each asset of `registry` is stored in the pack.
+ * @return false if any of the asset files doesn't exist; they are stored as
+ *         empty assets */
+static bool kpackBuildLayout(const KAssetRegistry& registry,
+                             const fs::path& fsPathAssets,
+                             KPackLayout& outLayout)
+{
+	bool success = true;
+	outLayout.assets.clear();
+	/* the offsets are determined by the path & size of each asset */
+	string layoutKey;
+	uint64_t offset = kpackAlign(sizeof(KPackHeader));
+	for(const string_view path : registry.paths)
+	{
+		KPackAsset asset =
+			{ .fileSize      = 0
+			, .lastWriteTime = 0
+			, .offset        = offset };
+		std::error_code errorCode;
+		const fs::directory_entry fsDirEnt(fsPathAssets / path, errorCode);
+		if(errorCode || !fsDirEnt.is_regular_file(errorCode))
+		{
+			fprintf(stderr, "Failed to find KASSET '%.*s' in '%ws'!\n",
+			        static_cast<int>(path.size()), path.data(),
+			        fsPathAssets.c_str());
+			success = false;
+		}
+		else
+		{
+			asset.fileSize      = fsDirEnt.file_size();
+			asset.lastWriteTime = kcacheLastWriteTime(fsDirEnt);
+		}
+		kcacheWriteString(layoutKey, path);
+		kcacheWrite(layoutKey, asset.fileSize);
+		outLayout.assets.push_back(asset);
+		offset = kpackAlign(offset + asset.fileSize);
+	}
+	outLayout.byteCount  = offset;
+	outLayout.layoutHash = kcacheHash(layoutKey.data(), layoutKey.size());
+	return success;
+}
+/** `outManifest` is left empty if the manifest doesn't exist or is invalid */
+static void kpackLoadManifest(const fs::path& fsPathManifest,
+                              KPackManifest& outManifest)
+{
+	std::error_code errorCode;
+	const uintmax_t fileSize = fs::file_size(fsPathManifest, errorCode);
+	if(errorCode)
+		return;
+	char*const fileData = readEntireFile(fsPathManifest.c_str(), fileSize);
+	if(!fileData)
+		return;
+	KCacheReader reader =
+		{ .at     = fileData
+		, .end    = fileData + fileSize
+		, .failed = fileSize < sizeof(uint64_t) };
+	if(!reader.failed)
+	{
+		/* the last 8 bytes of the file are a hash of everything before them */
+		reader.end -= sizeof(uint64_t);
+		uint64_t storedChecksum;
+		memcpy(&storedChecksum, reader.end, sizeof(storedChecksum));
+		if(storedChecksum != kcacheHash(fileData, reader.end - fileData))
+			reader.failed = true;
+	}
+	if(kcacheRead<uint32_t>(reader) != KPACK_MANIFEST_MAGIC ||
+		kcacheRead<uint32_t>(reader) != KPACK_MANIFEST_VERSION)
+		reader.failed = true;
+	outManifest.layoutHash = kcacheRead<uint64_t>(reader);
+	const uint32_t assetCount = kcacheRead<uint32_t>(reader);
+	for(uint32_t a = 0; a < assetCount && !reader.failed; a++)
+	{
+		const string_view path = kcacheReadStringView(reader);
+		KPackAsset asset;
+		asset.fileSize      = kcacheRead<uintmax_t>(reader);
+		asset.lastWriteTime = kcacheRead<int64_t>(reader);
+		asset.offset        = kcacheRead<uint64_t>(reader);
+		outManifest.assets.insert({string(path), asset});
+	}
+	if(reader.failed || reader.at != reader.end)
+		outManifest = {};
+	free(fileData);
+}
+static bool kpackSaveManifest(const fs::path& fsPathManifest,
+                              const KAssetRegistry& registry,
+                              const KPackLayout& layout)
+{
+	string buffer;
+	kcacheWrite(buffer, KPACK_MANIFEST_MAGIC);
+	kcacheWrite(buffer, KPACK_MANIFEST_VERSION);
+	kcacheWrite(buffer, layout.layoutHash);
+	kcacheWrite(buffer, static_cast<uint32_t>(registry.paths.size()));
+	for(size_t a = 0; a < registry.paths.size(); a++)
+	{
+		kcacheWriteString(buffer, registry.paths[a]);
+		kcacheWrite(buffer, layout.assets[a].fileSize);
+		kcacheWrite(buffer, layout.assets[a].lastWriteTime);
+		kcacheWrite(buffer, layout.assets[a].offset);
+	}
+	kcacheWrite(buffer, kcacheHash(buffer.data(), buffer.size()));
+	return writeEntireFileIfChanged(fsPathManifest, buffer);
+}
+/** Write the contents of an asset file at the current position of `file`.
+ * @return false if the asset could not be read or written */
+static bool kpackWriteAssetFile(FILE* file, const fs::path& fsPathAsset,
+                                uintmax_t fileSize)
+{
+	if(fileSize == 0)
+		return true;
+	/* the layout of the pack depends on the size of every asset, so an asset 
+		which has changed size since the layout was built can't be written */
+	uintmax_t openedFileSize = fileSize;
+	InputFile inputFile;
+	if(!openInputFile(fsPathAsset.c_str(), openedFileSize, inputFile))
+		return false;
+	if(openedFileSize != fileSize)
+	{
+		fprintf(stderr, "KASSET '%ws' changed while being packed!\n", 
+		        fsPathAsset.c_str());
+		closeInputFile(inputFile);
+		return false;
+	}
+	const bool success =
+		fwrite(inputFile.data, sizeof(char), fileSize, file) == fileSize;
+	closeInputFile(inputFile);
+	return success;
+}
+static bool kpackWritePadding(FILE* file, uint64_t byteCount)
+{
+	static const char zeros[KPACK_ALIGNMENT] = {};
+	assert(byteCount <= KPACK_ALIGNMENT);
+	return fwrite(zeros, sizeof(char), byteCount, file) == byteCount;
+}
+/** Open the previous pack, but only if its header shows that it was written
+ * with the layout recorded in `manifest`.  Otherwise the offsets in the
+ * manifest don't describe the pack, & none of its bytes can be reused.
+ * @return false if there is no usable previous pack, in which case
+ *         `outPreviousPack` is left empty */
+static bool kpackOpenPrevious(const fs::path& fsPathPack,
+                              const KPackManifest& manifest,
+                              InputFile& outPreviousPack)
+{
+	outPreviousPack = {};
+	std::error_code errorCode;
+	uintmax_t packSize = fs::file_size(fsPathPack, errorCode);
+	if(errorCode ||
+		!openInputFile(fsPathPack.c_str(), packSize, outPreviousPack))
+	{
+		outPreviousPack = {};
+		return false;
+	}
+	KPackHeader header = {};
+	if(outPreviousPack.size >= sizeof(header))
+		memcpy(&header, outPreviousPack.data, sizeof(header));
+	if(header.magic      != KPACK_MAGIC ||
+		header.version    != KPACK_VERSION ||
+		header.layoutHash != manifest.layoutHash ||
+		header.byteCount  != outPreviousPack.size)
+	{
+		closeInputFile(outPreviousPack);
+		outPreviousPack = {};
+		return false;
+	}
+	return true;
+}
+/** Write a new pack, copying the assets which haven't changed since the last
+ * run out of the previous pack (if there is one).  The previous pack is
+ * closed before it is replaced.
+ * @return false if the pack could not be written */
+static bool kpackRebuild(const fs::path& fsPathPack,
+                         const fs::path& fsPathAssets,
+                         const KAssetRegistry& registry,
+                         const KPackLayout& layout,
+                         const KPackManifest& manifest,
+                         InputFile& previousPack,
+                         size_t& outUpdatedAssetCount)
+{
+	std::error_code errorCode;
+	fs::path fsPathTemp = fsPathPack;
+	fsPathTemp += TEMP_FILE_EXTENSION;
+	FILE*const file = kpackOpenFile(fsPathTemp);
+	bool success = file != nullptr;
+	const KPackHeader header =
+		{ .magic      = KPACK_MAGIC
+		, .version    = KPACK_VERSION
+		, .layoutHash = layout.layoutHash
+		, .assetCount = registry.paths.size()
+		, .byteCount  = layout.byteCount };
+	uint64_t offset = sizeof(header);
+	if(success)
+		success = fwrite(&header, sizeof(header), 1, file) == 1;
+	for(size_t a = 0; a < registry.paths.size() && success; a++)
+	{
+		const KPackAsset& asset = layout.assets[a];
+		success = kpackWritePadding(file, asset.offset - offset);
+		offset = asset.offset + asset.fileSize;
+		const auto previous = manifest.assets.find(registry.paths[a]);
+		if(previousPack.data && previous != manifest.assets.end() &&
+			previous->second.fileSize == asset.fileSize &&
+			previous->second.lastWriteTime == asset.lastWriteTime &&
+			previous->second.offset + asset.fileSize <= previousPack.size)
+		{
+			success = success && fwrite(previousPack.data +
+				previous->second.offset, sizeof(char), asset.fileSize, file) ==
+					asset.fileSize;
+			continue;
+		}
+		success = success &&
+			kpackWriteAssetFile(file, fsPathAssets / registry.paths[a],
+			                    asset.fileSize);
+		outUpdatedAssetCount++;
+	}
+	if(success)
+		success = kpackWritePadding(file, layout.byteCount - offset);
+	if(file && fclose(file) != 0)
+		success = false;
+	/* the previous pack must be closed before it can be replaced */
+	if(previousPack.data)
+		closeInputFile(previousPack);
+	if(success)
+	{
+		fs::rename(fsPathTemp, fsPathPack, errorCode);
+		success = !errorCode;
+	}
+	if(!success)
+		fs::remove(fsPathTemp, errorCode);
+	return success;
+}
+/** Bring the pack in `fsPathOutput` up to date with `layout`.
+ * @return false if the pack could not be written */
+static bool kpackWrite(const fs::path& fsPathOutput,
+                       const fs::path& fsPathAssets,
+                       const KAssetRegistry& registry,
+                       const KPackLayout& layout)
+{
+	const fs::path fsPathPack     = fsPathOutput / KPACK_FILE_NAME;
+	const fs::path fsPathManifest = fsPathOutput / KPACK_MANIFEST_FILE_NAME;
+	KPackManifest manifest = {};
+	kpackLoadManifest(fsPathManifest, manifest);
+	InputFile previousPack;
+	const bool previousPackValid =
+		kpackOpenPrevious(fsPathPack, manifest, previousPack);
+	/* the previous pack is left alone if none of its assets have changed */
+	bool packUnchanged = previousPackValid && !manifest.assets.empty() &&
+		manifest.layoutHash == layout.layoutHash &&
+		previousPack.size == layout.byteCount;
+	for(size_t a = 0; a < registry.paths.size() && packUnchanged; a++)
+	{
+		const auto previous = manifest.assets.find(registry.paths[a]);
+		packUnchanged = previous != manifest.assets.end() &&
+			previous->second.fileSize == layout.assets[a].fileSize &&
+			previous->second.lastWriteTime == layout.assets[a].lastWriteTime;
+	}
+	if(packUnchanged)
+		closeInputFile(previousPack);
+	size_t updatedAssetCount = 0;
+	const bool success = packUnchanged ||
+		kpackRebuild(fsPathPack, fsPathAssets, registry, layout, manifest,
+		             previousPack, updatedAssetCount);
+	if(!success)
+	{
+		fprintf(stderr, "Failed to write KASSET pack '%ws'!\n",
+		        fsPathPack.c_str());
+		/* the pack's contents are unknown, so the next run must rebuild it */
+		std::error_code errorCode;
+		fs::remove(fsPathManifest, errorCode);
+		return false;
+	}
+	if(g_verbose)
+		printf("kasset pack: %zu/%zu assets updated\n", updatedAssetCount,
+		       registry.paths.size());
+	return kpackSaveManifest(fsPathManifest, registry, layout);
+}
@@ -1,12 +1,18 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
 #include <filesystem>
 #include <vector>
 using std::vector;
 #include <chrono>
+#include <atomic>
+#include <thread>
 #include <string>
 using std::string;
+#include <string_view>
+using std::string_view;
 #include <sstream>
 using std::stringstream;
 #include <set>
@@ -16,15 +22,28 @@ using std::map;
 namespace chrono = std::chrono;
 namespace fs = std::filesystem;
 #include "tokenizer.cpp"
+#include "prefilter.cpp"
+#include "arena.cpp"
+#include "intern.cpp"
+#include "emit.cpp"
 static bool g_verbose;
-static string g_lastPtuExtensionStructId = "---UNKNOWN---";
-#if KASSET_IMPLEMENTATION
-static vector<string> g_kassets;
-#endif// KASSET_IMPLEMENTATION
+static bool g_parseCacheEnabled;
+/* generate a function which prints the size of each PTU variant */
+static bool g_layoutReport;
+/* generate dispatchers which count their calls of each type */
+static bool g_instrument;
+/* generate a pack of all the KASSETs, which are found in this directory */
+static fs::path g_kassetPackDirectory;
+#include "kasset.cpp"
+/* StringTokens (and Parameter identifiers) are views into the source file 
+	buffers (or the parse cache) which they were parsed from, which keeps the 
+	parsers from making a heap allocation per token.  Once a source file is 
+	parsed, the text of its tokens is copied into a single buffer owned by its 
+	ParsedFile, so that the source file is never kept open. */
 struct StringToken
 {
 	KTokenType type;
-	string str;
+	string_view str;
 };
 struct PolymorphicTaggedUnionPureVirtualFunctionMetaData
 {
@@ -34,36 +53,91 @@ struct PolymorphicTaggedUnionPureVirtualFunctionMetaData
 		/* @TODO: delete this since it is implicitly the last qualifierToken, 
 			and the code which uses this data structure does NOT store preceding 
 			& trailing whitespace tokens!*/
-		string identifier;
+		string_view identifier;
 		vector<StringToken> qualifierTokens;
 	};
 	vector<Parameter> params;
 };
-struct PolymorphicTaggedUnionPureVirtualFunctionOverrideMetaData
+using PolymorphicTaggedUnionPureVirtualFunctionIdentifier = KSymbol;
+using TaggedUnionStructIdentifier = KSymbol;
+#include "database.cpp"
+/* A single PTU fact extracted from a source file.  Files are parsed 
+	concurrently, so the parsers never modify g_ptuDatabase directly.  
+	Instead, each file's events are merged into the database afterwards, in 
+	the same order that the files were found in the input directories. */
+struct PolymorphicTaggedUnionParseEvent
 {
-	string superFunctionIdentifier;
-	PolymorphicTaggedUnionPureVirtualFunctionMetaData functionMetaData;
+	enum class Type : uint8_t
+		{ DECLARATION
+		, EXTENSION
+		, PURE_VIRTUAL_FUNCTION
+		, PURE_VIRTUAL_FUNCTION_OVERRIDE } type;
+	TaggedUnionStructIdentifier ptuIdentifier;
+	/* only used by EXTENSION & PURE_VIRTUAL_FUNCTION_OVERRIDE */
+	KSymbol derivedStructIdentifier = KSYMBOL_INVALID;
+	/* only used by PURE_VIRTUAL_FUNCTION & PURE_VIRTUAL_FUNCTION_OVERRIDE */
+	PolymorphicTaggedUnionPureVirtualFunctionIdentifier functionIdentifier = 
+		KSYMBOL_INVALID;
+	/* only used by PURE_VIRTUAL_FUNCTION_OVERRIDE */
+	PolymorphicTaggedUnionPureVirtualFunctionIdentifier superFunctionIdentifier = 
+		KSYMBOL_INVALID;
+	/* only used by DECLARATION & PURE_VIRTUAL_FUNCTION; dispatch through a 
+		table of function pointers instead of a switch */
+	bool jumpTableDispatch = false;
+	/* only used by PURE_VIRTUAL_FUNCTION; batches must be dispatched in their 
+		original order instead of being grouped by type */
+	bool orderSensitive = false;
+	/* only used by EXTENSION; the derived struct is stored out of line, so 
+		the PTU's union only contains a pointer to it */
+	bool boxed = false;
+	/* only used by DECLARATION; the type tag overlaps the padding at the 
+		start of each variant instead of preceding the union */
+	bool packedTag = false;
+	PolymorphicTaggedUnionPureVirtualFunctionMetaData functionMetaData = {};
 };
-using PolymorphicTaggedUnionPureVirtualFunctionIdentifier = string;
-struct PolymorphicTaggedUnionMetaData
-{
-	map<PolymorphicTaggedUnionPureVirtualFunctionIdentifier, 
-	    PolymorphicTaggedUnionPureVirtualFunctionMetaData> virtualFunctions;
-	map<string, 
-		map<PolymorphicTaggedUnionPureVirtualFunctionIdentifier, 
-		    PolymorphicTaggedUnionPureVirtualFunctionOverrideMetaData>> 
-		derivedStructId_to_vFuncOverrides;
+/** The contents of an input source file, either mapped directly into memory 
+ * or read into a heap buffer when mapping is not possible. */
+struct InputFile
+{
+	const char* data;
+	uintmax_t size;
+	bool isMapped;
+};
+/* all parser state & results for a single input file */
+struct ParseCacheEntry;
+struct ParsedFile
+{
+	fs::path path;
+	uintmax_t fileSize    = 0;
+	int64_t lastWriteTime = 0;
+	bool readFailure      = false;
+	/* the file is unchanged since the last run, so `ptuEvents` have already 
+		been loaded from the parse cache & the file does not need to be read */
+	bool isCached = false;
+	/* if the file's modification time has changed since the last run, the 
+		cached facts can still be used if the file contents are identical */
+	const ParseCacheEntry* cacheEntry = nullptr;
+	uint64_t contentHash              = 0;
+	/* unless they were loaded from the parse cache, the StringTokens of 
+		`ptuEvents` & the `kassets` point into this buffer */
+	char* stringData = nullptr;
+	/* pure virtual function overrides are assumed to belong to the most 
+		recent PTU extension struct declared in the same file */
+	KSymbol lastPtuExtensionStructId = KSYMBOL_INVALID;
+	vector<PolymorphicTaggedUnionParseEvent> ptuEvents = {};
+	/* the contents of the string literal of each `KASSET("path")`, with 
+		their escape sequences still encoded */
+	vector<string_view> kassets = {};
 };
-using TaggedUnionStructIdentifier = string;
-static map<TaggedUnionStructIdentifier, PolymorphicTaggedUnionMetaData> 
-	g_polyTaggedUnions;
 #define PARSE_FAILURE() \
 	{ fprintf(stderr, "parse failure!\n");\
 	  assert(false);\
 	  exit(-1);\
 	  return; }
 static void 
-	kcppParsePolymorphicTaggedUnion(KTokenizer& tokenizer)
+	kcppParsePolymorphicTaggedUnion(KTokenizer& tokenizer, 
+	                                ParsedFile& parsedFile, 
+	                                bool jumpTableDispatch, bool packedTag)
 {
 	/* parse the `struct` keyword */
 	{
@@ -85,26 +159,32 @@ static void
 			kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
 		if(tokenStructId.type != KTokenType::IDENTIFIER)
 			PARSE_FAILURE();
-		const string tokenStr = 
-			string(tokenStructId.text, tokenStructId.textLength);
-		g_polyTaggedUnions.insert({tokenStr, {}});
+		parsedFile.ptuEvents.push_back(
+			{ .type              = 
+				PolymorphicTaggedUnionParseEvent::Type::DECLARATION
+			, .ptuIdentifier     = ksymbolIntern(
+				string_view(tokenStructId.text, tokenStructId.textLength))
+			, .jumpTableDispatch = jumpTableDispatch
+			, .packedTag         = packedTag });
 	}
 }
 static void 
-	kcppParsePolymorphicTaggedUnionExtension(KTokenizer& tokenizer)
+	kcppParsePolymorphicTaggedUnionExtension(KTokenizer& tokenizer, 
+	                                         ParsedFile& parsedFile, bool boxed)
 {
 	/* parse the parenthesis */
 	if(kcppRequireToken(tokenizer, KTokenType::PAREN_OPEN).type != 
 			KTokenType::PAREN_OPEN)
 		PARSE_FAILURE();
 	/* parse the tagged union struct identifier */
-	string parentStructId;
+	KSymbol parentStructId;
 	{
 		const KToken tokenStructId = 
 			kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
 		if(tokenStructId.type != KTokenType::IDENTIFIER)
 			PARSE_FAILURE();
-		parentStructId = string(tokenStructId.text, tokenStructId.textLength);
+		parentStructId = ksymbolIntern(
+			string_view(tokenStructId.text, tokenStructId.textLength));
 	}
 	/* parse the closing parenthesis */
 	if(kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE).type != 
@@ -127,25 +207,22 @@ static void
 			kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
 		if(tokenStructId.type != KTokenType::IDENTIFIER)
 			PARSE_FAILURE();
-		const string tokenStr = 
-			string(tokenStructId.text, tokenStructId.textLength);
+		const KSymbol structId = ksymbolIntern(
+			string_view(tokenStructId.text, tokenStructId.textLength));
 		/* now we can add this to the accumulated tagged union struct 
 			relationships */
-		auto ptuIt = g_polyTaggedUnions.find(parentStructId);
-		if(ptuIt == g_polyTaggedUnions.end())
-		{
-			g_polyTaggedUnions.insert({parentStructId, {}});
-			ptuIt = g_polyTaggedUnions.find(parentStructId);
-		}
-		if(ptuIt->second.derivedStructId_to_vFuncOverrides.contains(tokenStr))
-			PARSE_FAILURE();
-		ptuIt->second.derivedStructId_to_vFuncOverrides.insert({tokenStr, {}});
-		g_lastPtuExtensionStructId = tokenStr;
+		parsedFile.ptuEvents.push_back(
+			{ .type                    = 
+				PolymorphicTaggedUnionParseEvent::Type::EXTENSION
+			, .ptuIdentifier           = parentStructId
+			, .derivedStructIdentifier = structId
+			, .boxed                   = boxed });
+		parsedFile.lastPtuExtensionStructId = structId;
 	}
 }
 static void 
 	kcppParsePolymorphicTaggedUnionPureVirtualFunctionOverride(
-		KTokenizer& tokenizer)
+		KTokenizer& tokenizer, ParsedFile& parsedFile)
 {
 	/* read the derived struct name from the macro */
 	/* parse the parenthesis */
@@ -153,14 +230,14 @@ static void
 			KTokenType::PAREN_OPEN)
 		PARSE_FAILURE();
 	/* parse the derived struct identifier */
-	string dispatchFunctionId;
+	KSymbol dispatchFunctionId;
 	{
 		const KToken tokenStructId = 
 			kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
 		if(tokenStructId.type != KTokenType::IDENTIFIER)
 			PARSE_FAILURE();
-		dispatchFunctionId = 
-			string(tokenStructId.text, tokenStructId.textLength);
+		dispatchFunctionId = ksymbolIntern(
+			string_view(tokenStructId.text, tokenStructId.textLength));
 	}
 	/* parse the closing parenthesis */
 	if(kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE).type != 
@@ -168,7 +245,7 @@ static void
 		PARSE_FAILURE();
 	/* read all function qualifiers (all identifiers before the open paren, 
 		except for the last one because that's the function name) */
-	string functionIdentifier;
+	KSymbol functionIdentifier;
 	vector<StringToken> functionQualifiers;
 	KTokenType lastFunctionQualifierTokenType;
 	for(;;)
@@ -179,7 +256,7 @@ static void
 			function name */
 		{
 			assert(lastFunctionQualifierTokenType == KTokenType::IDENTIFIER);
-			functionIdentifier = functionQualifiers.back().str;
+			functionIdentifier = ksymbolIntern(functionQualifiers.back().str);
 			functionQualifiers.pop_back();
 			break;
 		}
@@ -187,13 +264,13 @@ static void
 		{
 			functionQualifiers.push_back(
 				{ .type = token.type
-				, .str  = string(token.text, token.textLength)});
+				, .str  = string_view(token.text, token.textLength)});
 		}
 		lastFunctionQualifierTokenType = token.type;
 	}
 	/* read all the parameter qualifiers for each param (all non-whitespace 
 		tokens between each comma token) */
-	string ownerPtuIdentifier;
+	KSymbol ownerPtuIdentifier;
 	vector<PolymorphicTaggedUnionPureVirtualFunctionMetaData::Parameter> 
 		functionParams;
 	PolymorphicTaggedUnionPureVirtualFunctionMetaData::Parameter currParam;
@@ -244,61 +321,41 @@ static void
 		{
 			currParam.qualifierTokens.push_back(
 				{ .type = token.type
-				, .str  = string(token.text, token.textLength)});
+				, .str  = string_view(token.text, token.textLength)});
 		}
 	}
 	/* functions are REQUIRED to have a pointer to the PTU struct as the first 
 		parameter! (this pointer) */
 	assert(!functionParams.empty());
-	ownerPtuIdentifier = functionParams.front().qualifierTokens.front().str;
-	assert(!ownerPtuIdentifier.empty());
-	/* store all these tokens as a single data structure in some data set inside 
-		g_polyTaggedUnions */
-	{
-		/* first we have to make sure the owner PTU exists in the PTU database, 
-			because we don't know what order the source files will be parsed 
-			in! */
-		auto ptuIt = g_polyTaggedUnions.find(ownerPtuIdentifier);
-		if(ptuIt == g_polyTaggedUnions.end())
-		{
-			auto insertionResultPair = 
-				g_polyTaggedUnions.insert({ownerPtuIdentifier, {}});
-			assert(insertionResultPair.second);
-			ptuIt = insertionResultPair.first;
-		}
-		/* add the data of this PTU pure virtual override function to the 
-			derivedStructId_to_vFuncOverrides member of the PTU in the 
-			database.  This is where we can utilize 
-			g_lastPtuExtensionStructId, and assume this override function 
-			belongs to that struct */
-		auto subPtuIt = ptuIt->second.derivedStructId_to_vFuncOverrides.find(
-			g_lastPtuExtensionStructId);
-		if(subPtuIt == ptuIt->second.derivedStructId_to_vFuncOverrides.end())
-		{
-			auto insertionResultPair = 
-				ptuIt->second.derivedStructId_to_vFuncOverrides.insert(
-					{g_lastPtuExtensionStructId, {}});
-			assert(insertionResultPair.second);
-			subPtuIt = insertionResultPair.first;
-		}
-		/* add the functionIdentifier to vFuncOverrides database, ensuring that 
-			it only ever gets added ONCE */
-		auto vFuncOverrideIt = subPtuIt->second.find(functionIdentifier);
-		assert(vFuncOverrideIt == subPtuIt->second.end());
-		PolymorphicTaggedUnionPureVirtualFunctionOverrideMetaData vFuncOverride;
-		vFuncOverride.superFunctionIdentifier          = dispatchFunctionId;
-		vFuncOverride.functionMetaData.params          = functionParams;
-		vFuncOverride.functionMetaData.qualifierTokens = functionQualifiers;
-		subPtuIt->second.insert({functionIdentifier, vFuncOverride});
-	}
+	assert(!functionParams.front().qualifierTokens.front().str.empty());
+	ownerPtuIdentifier = 
+		ksymbolIntern(functionParams.front().qualifierTokens.front().str);
+	/* store all these tokens as a single data structure which will be merged 
+		into g_ptuDatabase.  This is where we can utilize 
+		lastPtuExtensionStructId, and assume this override function belongs to 
+		that struct */
+	parsedFile.ptuEvents.push_back(
+		{ .type                    = 
+			PolymorphicTaggedUnionParseEvent::Type::PURE_VIRTUAL_FUNCTION_OVERRIDE
+		, .ptuIdentifier           = ownerPtuIdentifier
+		, .derivedStructIdentifier = 
+			parsedFile.lastPtuExtensionStructId != KSYMBOL_INVALID 
+				? parsedFile.lastPtuExtensionStructId 
+				: ksymbolIntern("---UNKNOWN---")
+		, .functionIdentifier      = functionIdentifier
+		, .superFunctionIdentifier = dispatchFunctionId
+		, .functionMetaData        = 
+			{ .qualifierTokens = functionQualifiers
+			, .params          = functionParams } });
 }
 static void 
 	kcppParsePolymorphicTaggedUnionPureVirtualFunctionDefinition(
-		KTokenizer& tokenizer)
+		KTokenizer& tokenizer, ParsedFile& parsedFile, bool jumpTableDispatch, 
+		bool orderSensitive)
 {
 	/* continue parsing identifier tokens until we reach an open parenthesis,
 		storing the function identifier strings as we go */
-	string functionIdentifier;
+	KSymbol functionIdentifier;
 	vector<StringToken> functionQualifiers;
 	KTokenType lastFunctionQualifierTokenType;
 	for(;;)
@@ -309,7 +366,7 @@ static void
 			function name */
 		{
 			assert(lastFunctionQualifierTokenType == KTokenType::IDENTIFIER);
-			functionIdentifier = functionQualifiers.back().str;
+			functionIdentifier = ksymbolIntern(functionQualifiers.back().str);
 			functionQualifiers.pop_back();
 			break;
 		}
@@ -317,13 +374,13 @@ static void
 		{
 			functionQualifiers.push_back(
 				{ .type = token.type
-				, .str  = string(token.text, token.textLength)});
+				, .str  = string_view(token.text, token.textLength)});
 		}
 		lastFunctionQualifierTokenType = token.type;
 	}
 	/* continue parsing tokens until we reach a close paren, storing all the 
 		tokens as we go */
-	string ownerPtuIdentifier;
+	KSymbol ownerPtuIdentifier;
 	vector<PolymorphicTaggedUnionPureVirtualFunctionMetaData::Parameter> 
 		functionParams;
 	PolymorphicTaggedUnionPureVirtualFunctionMetaData::Parameter currParam;
@@ -374,363 +431,474 @@ static void
 		{
 			currParam.qualifierTokens.push_back(
 				{ .type = token.type
-				, .str  = string(token.text, token.textLength)});
+				, .str  = string_view(token.text, token.textLength)});
 		}
 	}
 	/* functions are REQUIRED to have a pointer to the PTU struct as the first 
 		parameter! (this pointer) */
 	assert(!functionParams.empty());
-	ownerPtuIdentifier = functionParams.front().qualifierTokens.front().str;
-	assert(!ownerPtuIdentifier.empty());
-	/* save this pure virtual function declaration inside g_polyTaggedUnions so 
-		we can generate dispatch code to automatically call functions which 
-		override this */
-	auto ptuIt = g_polyTaggedUnions.find(ownerPtuIdentifier);
-	if(ptuIt == g_polyTaggedUnions.end())
-	{
-		g_polyTaggedUnions.insert({ownerPtuIdentifier, {}});
-		ptuIt = g_polyTaggedUnions.find(ownerPtuIdentifier);
-	}
-	/* ensure that there is only ONE virtual function with this identifier 
-		declared for this polymorphic tagged union! */
-	auto pvfIt = ptuIt->second.virtualFunctions.find(functionIdentifier);
-	assert(pvfIt == ptuIt->second.virtualFunctions.end());
-	/* finally, we can add the extracted function declaration to the virtual 
-		function set of this PTU */
-	ptuIt->second.virtualFunctions[functionIdentifier] = 
-		{ .qualifierTokens = functionQualifiers
-		, .params          = functionParams };
-}
-#if KASSET_IMPLEMENTATION
-static void kcppParseKAssetInclude(KTokenizer& tokenizer, string& outString)
-{
-	if(kcppRequireToken(tokenizer, KTokenType::PAREN_OPEN).type == 
-		KTokenType::PAREN_OPEN)
-	{
-		outString.append("#include \"gen_kassets.h\"");
-		kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE);
-	}
-	else
-	{
-		fprintf(stderr, "kcppParseKAssetInclude failed!\n"); assert(false); 
-	}
+	assert(!functionParams.front().qualifierTokens.front().str.empty());
+	ownerPtuIdentifier = 
+		ksymbolIntern(functionParams.front().qualifierTokens.front().str);
+	/* save this pure virtual function declaration so that it is merged into 
+		g_ptuDatabase & we can generate dispatch code to automatically call 
+		functions which override this */
+	parsedFile.ptuEvents.push_back(
+		{ .type               = 
+			PolymorphicTaggedUnionParseEvent::Type::PURE_VIRTUAL_FUNCTION
+		, .ptuIdentifier      = ownerPtuIdentifier
+		, .functionIdentifier = functionIdentifier
+		, .jumpTableDispatch  = jumpTableDispatch
+		, .orderSensitive     = orderSensitive
+		, .functionMetaData   = 
+			{ .qualifierTokens = functionQualifiers
+			, .params          = functionParams } });
 }
-static void kcppParseKAsset(KTokenizer& tokenizer, string& outString)
+/** Apply all the PTU facts of a parsed file to the PTU database. */
+static void mergeParsedFile(const ParsedFile& parsedFile)
 {
-	if(kcppRequireToken(tokenizer, KTokenType::PAREN_OPEN).type == 
-		KTokenType::PAREN_OPEN)
+	KPtuDatabase& db = g_ptuDatabase;
+	for(const PolymorphicTaggedUnionParseEvent& event : parsedFile.ptuEvents)
 	{
-		KToken tokenAssetString = 
-			kcppRequireToken(tokenizer, KTokenType::STRING);
-		if(tokenAssetString.type == KTokenType::STRING)
+		/* we have to make sure the PTU exists in the PTU database, because we 
+			don't know what order the declarations will be parsed in! */
+		const uint32_t ptu = kptuFindOrInsertPtu(db, event.ptuIdentifier);
+		switch(event.type)
 		{
-			const string strKasset(tokenAssetString.text, 
-			                       tokenAssetString.textLength);
-			auto itKasset = find(g_kassets.begin(), g_kassets.end(), strKasset);
-			size_t kAssetIndex = g_kassets.size();
-			if(itKasset == g_kassets.end())
+			case PolymorphicTaggedUnionParseEvent::Type::DECLARATION:
+				if(event.jumpTableDispatch)
+					db.ptus[ptu].jumpTableDispatch = true;
+				if(event.packedTag)
+					db.ptus[ptu].packedTag = true;
+				break;
+			case PolymorphicTaggedUnionParseEvent::Type::EXTENSION:
 			{
-				g_kassets.push_back(strKasset);
-			}
-			else
+				const KSymbol derivedStructId = event.derivedStructIdentifier;
+				if(kptuFindDerivedStruct(db, ptu, derivedStructId) != 
+						KPTU_INVALID_INDEX)
+					PARSE_FAILURE();
+				kptuInsertDerivedStruct(db, ptu, derivedStructId, event.boxed);
+			}break;
+			case PolymorphicTaggedUnionParseEvent::Type::PURE_VIRTUAL_FUNCTION:
 			{
-				kAssetIndex = itKasset - g_kassets.begin();
-			}
-			stringstream ss;
-			ss << "&g_kassets[" << kAssetIndex << "]";
-			outString.append(ss.str());
-			kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE);
-		}
-		else
-		{
-			fprintf(stderr, "kcppParseKAsset failed 2!\n"); assert(false); 
+				const KSymbol functionId = event.functionIdentifier;
+				/* ensure that there is only ONE virtual function with this 
+					identifier declared for this polymorphic tagged union! */
+				const uint32_t virtualFunction = 
+					kptuFindVirtualFunction(db, ptu, functionId);
+				assert(virtualFunction == KPTU_INVALID_INDEX);
+				const KPtuFunctionSignature signature = 
+					kptuPushFunctionSignature(db, event.functionMetaData);
+				if(virtualFunction == KPTU_INVALID_INDEX)
+					kptuInsertVirtualFunction(db, ptu, functionId, signature, 
+					                          event.jumpTableDispatch, 
+					                          event.orderSensitive);
+				else
+				{
+					KPtuVirtualFunction& existing = 
+						db.virtualFunctions[virtualFunction];
+					existing.signature         = signature;
+					existing.jumpTableDispatch = event.jumpTableDispatch;
+					existing.orderSensitive    = event.orderSensitive;
+				}
+			}break;
+			case PolymorphicTaggedUnionParseEvent::Type::
+				PURE_VIRTUAL_FUNCTION_OVERRIDE:
+			{
+				/* add the data of this PTU pure virtual override function to 
+					the derived struct of the PTU in the database */
+				const KSymbol derivedStructId = event.derivedStructIdentifier;
+				uint32_t derivedStruct = 
+					kptuFindDerivedStruct(db, ptu, derivedStructId);
+				if(derivedStruct == KPTU_INVALID_INDEX)
+					derivedStruct = 
+						kptuInsertDerivedStruct(db, ptu, derivedStructId, false);
+				/* add the functionIdentifier to the derived struct's function 
+					overrides, ensuring that it only ever gets added ONCE */
+				const KSymbol functionId = event.functionIdentifier;
+				const uint32_t functionOverride = 
+					kptuFindFunctionOverride(db, derivedStruct, functionId);
+				assert(functionOverride == KPTU_INVALID_INDEX);
+				if(functionOverride != KPTU_INVALID_INDEX)
+					break;
+				kptuInsertFunctionOverride(
+					db, derivedStruct, functionId, 
+					event.superFunctionIdentifier, 
+					kptuPushFunctionSignature(db, event.functionMetaData));
+			}break;
 		}
 	}
-	else
-	{
-		fprintf(stderr, "kcppParseKAsset failed!\n"); assert(false); 
-	}
 }
-static void kcppParseKAssetSearch(KTokenizer& tokenizer, string& outString)
+static void kcppParseKAsset(KTokenizer& tokenizer, ParsedFile& parsedFile)
 {
-	if(kcppRequireToken(tokenizer, KTokenType::PAREN_OPEN).type == 
-		KTokenType::PAREN_OPEN)
-	{
-		KToken tokenAssetFileNamePu8 = 
-			kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
-		if(tokenAssetFileNamePu8.type == KTokenType::IDENTIFIER)
-		{
-			const string strPu8(tokenAssetFileNamePu8.text, 
-			                    tokenAssetFileNamePu8.textLength);
-			stringstream ss;
-			ss << "findKAssetCStr(" << strPu8 << ")";
-			outString.append(ss.str());
-			kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE);
-		}
-		else
-		{
-			fprintf(stderr, "kcppParseKAssetSearch failed 2!\n"); assert(false); 
-		}
-	}
-	else
+	/* parse the parenthesis */
+	if(kcppRequireToken(tokenizer, KTokenType::PAREN_OPEN).type != 
+			KTokenType::PAREN_OPEN)
+		PARSE_FAILURE();
+	/* parse the asset path string literal */
+	const KToken tokenPath = kcppRequireToken(tokenizer, KTokenType::STRING);
+	if(tokenPath.type != KTokenType::STRING)
+		PARSE_FAILURE();
+	const string_view path(tokenPath.text, tokenPath.textLength);
+	string decodedPath;
+	if(!kassetDecodeLiteral(path, decodedPath) || decodedPath.empty())
 	{
-		fprintf(stderr, "kcppParseKAssetSearch failed!\n"); assert(false); 
+		fprintf(stderr, "'%ws': unsupported KASSET path \"%.*s\"!\n", 
+		        parsedFile.path.c_str(), static_cast<int>(path.size()), 
+		        path.data());
+		PARSE_FAILURE();
 	}
+	/* parse the closing parenthesis */
+	if(kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE).type != 
+			KTokenType::PAREN_CLOSE)
+		PARSE_FAILURE();
+	parsedFile.kassets.push_back(path);
 }
-static void kcppParseKAssetCStr(KTokenizer& tokenizer, string& outString)
+static void kcppParseMacroDefinition(KTokenizer& tokenizer, string& outString)
 {
-	if(kcppRequireToken(tokenizer, KTokenType::PAREN_OPEN).type == 
-		KTokenType::PAREN_OPEN)
+	const char* macroDef = tokenizer.at;
+	size_t macroDefSize = 0;
+	while(tokenizer.at[0] && !isEndOfLine(tokenizer.at[0]))
 	{
-		KToken tokenAssetIndex = 
-			kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
-		if(tokenAssetIndex.type == KTokenType::IDENTIFIER)
-		{
-			const string strSizeT(tokenAssetIndex.text, 
-			                      tokenAssetIndex.textLength);
-			stringstream ss;
-			ss << "g_kassets[" << strSizeT << "]";
-			outString.append(ss.str());
-			kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE);
-		}
-		else
+		if(tokenizer.at[0] == '\\' && isEndOfLine(tokenizer.at[1]))
 		{
-			fprintf(stderr, "kcppParseKAssetCStr failed 2!\n"); assert(false); 
-		}
-	}
-	else
-	{
-		fprintf(stderr, "kcppParseKAssetCStr failed!\n"); assert(false); 
-	}
-}
-static void kcppParseKAssetIndex(KTokenizer& tokenizer, string& outString)
-{
-	if(kcppRequireToken(tokenizer, KTokenType::PAREN_OPEN).type == 
-		KTokenType::PAREN_OPEN)
-	{
-		KToken tokenAssetString = 
-			kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
-		if(tokenAssetString.type == KTokenType::IDENTIFIER)
-		{
-			const string strKAssetCStr(tokenAssetString.text, 
-			                           tokenAssetString.textLength);
-			stringstream ss;
-			ss << "static_cast<u32>("<< strKAssetCStr << " - g_kassets)";
-			outString.append(ss.str());
-			kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE);
+			do
+			{
+				tokenizer.at++;
+				macroDefSize++;
+			} while (isEndOfLine(tokenizer.at[0]));
 		}
 		else
 		{
-			fprintf(stderr, "kcppParseKAsset failed 2!\n"); assert(false); 
+			tokenizer.at++;
+			macroDefSize++;
 		}
 	}
-	else
-	{
-		fprintf(stderr, "kcppParseKAsset failed!\n"); assert(false); 
-	}
+	outString.append(macroDef, macroDefSize);
 }
-static void kcppParseKAssetType(KTokenizer& tokenizer, string& outString)
+/* Every macro which kcpp responds to is registered here.  Identifiers are 
+	resolved to a keyword with a single lookup into a perfect hash table which 
+	is generated at compile time, so adding more keywords does not make 
+	`processToken` any slower. */
+enum class KcppKeyword : uint8_t
+	{ NONE
+	, POLYMORPHIC_TAGGED_UNION
+	, POLYMORPHIC_TAGGED_UNION_EXTENDS
+	, POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL
+	, POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_OVERRIDE
+	, POLYMORPHIC_TAGGED_UNION_JUMP_TABLE
+	, POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_JUMP_TABLE
+	, POLYMORPHIC_TAGGED_UNION_ORDER_SENSITIVE
+	, POLYMORPHIC_TAGGED_UNION_EXTENDS_BOXED
+	, POLYMORPHIC_TAGGED_UNION_PACKED
+	, KASSET
+	, ENUM_COUNT };
+struct KcppKeywordInfo
 {
-	if(kcppRequireToken(tokenizer, KTokenType::PAREN_OPEN).type == 
-		KTokenType::PAREN_OPEN)
-	{
-		KToken tokenAssetString = 
-			kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
-		if(tokenAssetString.type == KTokenType::IDENTIFIER)
-		{
-			const string strKAssetCStr(tokenAssetString.text, 
-			                           tokenAssetString.textLength);
-			stringstream ss;
-			ss << "g_kassetFileTypes[("<< strKAssetCStr << " - g_kassets)]";
-			outString.append(ss.str());
-			kcppRequireToken(tokenizer, KTokenType::PAREN_CLOSE);
-		}
-		else
-		{
-			fprintf(stderr, "kcppParseKAsset failed 2!\n"); assert(false); 
-		}
-	}
-	else
-	{
-		fprintf(stderr, "kcppParseKAsset failed!\n"); assert(false); 
-	}
-}
-static void kcppParseKAssetCount(KTokenizer& tokenizer, string& outString)
+	const char* identifier;
+	KcppKeyword keyword;
+};
+static constexpr KcppKeywordInfo g_kcppKeywords[] = 
+	{ {"KCPP_POLYMORPHIC_TAGGED_UNION", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION}
+	, {"KCPP_POLYMORPHIC_TAGGED_UNION_EXTENDS", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION_EXTENDS}
+	, {"KCPP_POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL}
+	, {"KCPP_POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_OVERRIDE", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_OVERRIDE}
+	/* opt-in variants of the declarations above, whose dispatchers are 
+		generated as a jump table; for an entire PTU, or for a single pure 
+		virtual function */
+	, {"KCPP_POLYMORPHIC_TAGGED_UNION_JUMP_TABLE", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION_JUMP_TABLE}
+	, {"KCPP_POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_JUMP_TABLE", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_JUMP_TABLE}
+	/* modifies the pure virtual function declaration which follows it */
+	, {"KCPP_POLYMORPHIC_TAGGED_UNION_ORDER_SENSITIVE", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION_ORDER_SENSITIVE}
+	/* opt-in variant of KCPP_POLYMORPHIC_TAGGED_UNION_EXTENDS, whose derived 
+		struct is stored out of line so that it doesn't inflate the union */
+	, {"KCPP_POLYMORPHIC_TAGGED_UNION_EXTENDS_BOXED", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION_EXTENDS_BOXED}
+	/* modifies the PTU declaration which follows it */
+	, {"KCPP_POLYMORPHIC_TAGGED_UNION_PACKED", 
+	   KcppKeyword::POLYMORPHIC_TAGGED_UNION_PACKED}
+	/* registers an asset path; the rest of the KASSET macros are defined by 
+		the generated registry header */
+	, {"KASSET", KcppKeyword::KASSET}
+	};
+static constexpr size_t KCPP_KEYWORD_COUNT = 
+	sizeof(g_kcppKeywords) / sizeof(g_kcppKeywords[0]);
+static_assert(KCPP_KEYWORD_COUNT == 
+	static_cast<size_t>(KcppKeyword::ENUM_COUNT) - 1, 
+	"every KcppKeyword must be registered in g_kcppKeywords!");
+static constexpr int kcppConstexprStrlen(const char* cStr)
 {
-	outString.append("(sizeof(g_kassets)/sizeof(g_kassets[0]))");
+	int result = 0;
+	while(cStr[result])
+		result++;
+	return result;
 }
-static void kcppParseKAssetTypePng(KTokenizer& tokenizer, string& outString)
+/* the hash only looks at the identifier's length & the few characters which 
+	distinguish the keywords from each other; the keyword candidate is then 
+	verified with a full string compare */
+static constexpr uint32_t kcppKeywordHash(
+	const char* text, int textLength, uint32_t seed)
 {
-	outString.append("KAssetFileType::PNG");
+	uint32_t hash = static_cast<uint32_t>(textLength);
+	hash = hash*seed + static_cast<uint8_t>(text[0]);
+	hash = hash*seed + static_cast<uint8_t>(text[textLength - 1]);
+	hash = hash*seed + static_cast<uint8_t>(text[textLength - 2]);
+	return hash ^ (hash >> 15);
 }
-static void kcppParseKAssetTypeWav(KTokenizer& tokenizer, string& outString)
+struct KcppKeywordHashTable
 {
-	outString.append("KAssetFileType::WAV");
-}
-static void kcppParseKAssetTypeOgg(KTokenizer& tokenizer, string& outString)
+	/* must be a power of two */
+	static constexpr uint32_t SLOT_COUNT = 64;
+	static constexpr uint8_t EMPTY_SLOT = 0xFF;
+	uint32_t seed;
+	int minIdentifierLength;
+	int maxIdentifierLength;
+	/* index into g_kcppKeywords for each slot, or EMPTY_SLOT */
+	uint8_t slots[SLOT_COUNT];
+	int identifierLengths[KCPP_KEYWORD_COUNT];
+};
+/** Search for a hash seed which maps every keyword to a unique slot. */
+static constexpr KcppKeywordHashTable kcppBuildKeywordHashTable()
 {
-	outString.append("KAssetFileType::OGG");
+	static_assert(KCPP_KEYWORD_COUNT < KcppKeywordHashTable::EMPTY_SLOT);
+	KcppKeywordHashTable result = {};
+	result.minIdentifierLength = 0x7FFFFFFF;
+	for(size_t k = 0; k < KCPP_KEYWORD_COUNT; k++)
+	{
+		const int length = kcppConstexprStrlen(g_kcppKeywords[k].identifier);
+		result.identifierLengths[k] = length;
+		result.minIdentifierLength = std::min(result.minIdentifierLength, length);
+		result.maxIdentifierLength = std::max(result.maxIdentifierLength, length);
+	}
+	for(uint32_t seed = 1; seed < 0x10000; seed += 2)
+	{
+		for(uint32_t s = 0; s < KcppKeywordHashTable::SLOT_COUNT; s++)
+			result.slots[s] = KcppKeywordHashTable::EMPTY_SLOT;
+		bool collision = false;
+		for(size_t k = 0; k < KCPP_KEYWORD_COUNT && !collision; k++)
+		{
+			const uint32_t slot = 
+				kcppKeywordHash(g_kcppKeywords[k].identifier, 
+				                result.identifierLengths[k], seed) & 
+				(KcppKeywordHashTable::SLOT_COUNT - 1);
+			collision = result.slots[slot] != KcppKeywordHashTable::EMPTY_SLOT;
+			result.slots[slot] = static_cast<uint8_t>(k);
+		}
+		if(!collision)
+		{
+			result.seed = seed;
+			return result;
+		}
+	}
+	/* we failed to find a perfect hash; increase SLOT_COUNT! */
+	result.seed = 0;
+	return result;
 }
-static void kcppParseKAssetTypeFlipbookMeta(KTokenizer& tokenizer, 
-                                            string& outString)
+static constexpr KcppKeywordHashTable g_kcppKeywordHashTable = 
+	kcppBuildKeywordHashTable();
+static_assert(g_kcppKeywordHashTable.seed != 0, 
+	"failed to generate a perfect hash for g_kcppKeywords!");
+static KcppKeyword kcppLookupKeyword(const KToken& token)
 {
-	outString.append("KAssetFileType::FLIPBOOK_META");
+	if(token.textLength < g_kcppKeywordHashTable.minIdentifierLength || 
+		token.textLength > g_kcppKeywordHashTable.maxIdentifierLength)
+		return KcppKeyword::NONE;
+	const uint32_t slot = 
+		kcppKeywordHash(token.text, token.textLength, 
+		                g_kcppKeywordHashTable.seed) & 
+		(KcppKeywordHashTable::SLOT_COUNT - 1);
+	const uint8_t k = g_kcppKeywordHashTable.slots[slot];
+	if(k == KcppKeywordHashTable::EMPTY_SLOT || 
+		g_kcppKeywordHashTable.identifierLengths[k] != token.textLength || 
+		memcmp(g_kcppKeywords[k].identifier, token.text, token.textLength) != 0)
+		return KcppKeyword::NONE;
+	return g_kcppKeywords[k].keyword;
 }
-static void kcppParseKAssetTypeUnknown(KTokenizer& tokenizer, string& outString)
+/* Batches of instances are normally grouped by type before they are 
+	dispatched.  This modifier marks the pure virtual function declared 
+	immediately after it as one whose batches must be dispatched in order. */
+static void 
+	kcppParsePolymorphicTaggedUnionOrderSensitive(KTokenizer& tokenizer, 
+	                                              ParsedFile& parsedFile)
 {
-	outString.append("KAssetFileType::UNKNOWN");
+	const KToken tokenKeyword = 
+		kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
+	if(tokenKeyword.type != KTokenType::IDENTIFIER)
+		PARSE_FAILURE();
+	switch(kcppLookupKeyword(tokenKeyword))
+	{
+		case KcppKeyword::POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL:
+			kcppParsePolymorphicTaggedUnionPureVirtualFunctionDefinition(
+				tokenizer, parsedFile, false, true);
+		break;
+		case KcppKeyword::POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_JUMP_TABLE:
+			kcppParsePolymorphicTaggedUnionPureVirtualFunctionDefinition(
+				tokenizer, parsedFile, true, true);
+		break;
+		default:
+			PARSE_FAILURE();
+	}
 }
-#endif// KASSET_IMPLEMENTATION
-static void kcppParseMacroDefinition(KTokenizer& tokenizer, string& outString)
+/* This modifier marks the PTU declared immediately after it as one whose type 
+	tag is packed into the union, at the start of each variant. */
+static void 
+	kcppParsePolymorphicTaggedUnionPacked(KTokenizer& tokenizer, 
+	                                      ParsedFile& parsedFile)
 {
-	const char* macroDef = tokenizer.at;
-	size_t macroDefSize = 0;
-	while(tokenizer.at[0] && !isEndOfLine(tokenizer.at[0]))
+	const KToken tokenKeyword = 
+		kcppRequireToken(tokenizer, KTokenType::IDENTIFIER);
+	if(tokenKeyword.type != KTokenType::IDENTIFIER)
+		PARSE_FAILURE();
+	switch(kcppLookupKeyword(tokenKeyword))
 	{
-		if(tokenizer.at[0] == '\\' && isEndOfLine(tokenizer.at[1]))
-		{
-			do
-			{
-				tokenizer.at++;
-				macroDefSize++;
-			} while (isEndOfLine(tokenizer.at[0]));
-		}
-		else
-		{
-			tokenizer.at++;
-			macroDefSize++;
-		}
+		case KcppKeyword::POLYMORPHIC_TAGGED_UNION:
+			kcppParsePolymorphicTaggedUnion(tokenizer, parsedFile, false, true);
+		break;
+		case KcppKeyword::POLYMORPHIC_TAGGED_UNION_JUMP_TABLE:
+			kcppParsePolymorphicTaggedUnion(tokenizer, parsedFile, true, true);
+		break;
+		default:
+			PARSE_FAILURE();
 	}
-	outString.append(macroDef, macroDefSize);
 }
-static void processFileData(const char* fileData)
+/** @return false if the end of the token stream has been reached */
+static bool processToken(KTokenizer& tokenizer, const KToken& token, 
+                         ParsedFile& parsedFile)
 {
-	//string result;
 	bool parsing = true;
-	KTokenizer tokenizer = {.at = fileData };
-	while(parsing)
-	{
-		KToken token = ktokeNext(tokenizer);
 #if 0
-		printf("%d:'%.*s'\n", token.type, token.textLength, token.text);
-		if( ktokeEquals(token, "stb_decompress") ||
-			ktokeEquals(token, "proggy_clean_ttf_compressed_data_base85"))
-		{
-			fflush(stdout);
-			printf("hello");
-		}
+	printf("%d:'%.*s'\n", token.type, token.textLength, token.text);
+	if( ktokeEquals(token, "stb_decompress") ||
+		ktokeEquals(token, "proggy_clean_ttf_compressed_data_base85"))
+	{
+		fflush(stdout);
+		printf("hello");
+	}
 #endif// 0
-		switch(token.type)
+	switch(token.type)
+	{
+		case KTokenType::HASH_TAG:
 		{
-			case KTokenType::HASH_TAG:
+			KToken tokenNext = ktokeNext(tokenizer);
+//			result.append(token.text, token.textLength);
+//			result.append(tokenNext.text, tokenNext.textLength);
+			if(tokenNext.type == KTokenType::IDENTIFIER &&
+				ktokeEquals(tokenNext, "define"))
 			{
-				KToken tokenNext = ktokeNext(tokenizer);
-//				result.append(token.text, token.textLength);
-//				result.append(tokenNext.text, tokenNext.textLength);
-				if(tokenNext.type == KTokenType::IDENTIFIER &&
-					ktokeEquals(tokenNext, "define"))
-				{
-					string macroDefinition;
-					kcppParseMacroDefinition(tokenizer, macroDefinition);
-				}
-			}break;
-			case KTokenType::IDENTIFIER:
+				string macroDefinition;
+				kcppParseMacroDefinition(tokenizer, macroDefinition);
+			}
+		}break;
+		case KTokenType::IDENTIFIER:
+		{
+			switch(kcppLookupKeyword(token))
 			{
-				if(ktokeEquals(token, "KCPP_POLYMORPHIC_TAGGED_UNION"))
-				{
-					kcppParsePolymorphicTaggedUnion(tokenizer);
-				}
-				if(ktokeEquals(token, "KCPP_POLYMORPHIC_TAGGED_UNION_EXTENDS"))
-				{
-					kcppParsePolymorphicTaggedUnionExtension(tokenizer);
-				}
-				if(ktokeEquals(
-					token, "KCPP_POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL"))
-				{
-					kcppParsePolymorphicTaggedUnionPureVirtualFunctionDefinition(tokenizer);
-				}
-				if(ktokeEquals(
-					token, 
-					"KCPP_POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_OVERRIDE"))
-				{
-					kcppParsePolymorphicTaggedUnionPureVirtualFunctionOverride(tokenizer);
-				}
-#if KASSET_IMPLEMENTATION
-				if(ktokeEquals(token, "INCLUDE_KASSET"))
-				{
-					kcppParseKAssetInclude(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET"))
-				{
-					kcppParseKAsset(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_SEARCH"))
-				{
-					kcppParseKAssetSearch(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_CSTR"))
-				{
-					kcppParseKAssetCStr(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_INDEX"))
-				{
-					kcppParseKAssetIndex(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_TYPE"))
-				{
-					kcppParseKAssetType(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_COUNT"))
-				{
-					kcppParseKAssetCount(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_TYPE_PNG"))
-				{
-					kcppParseKAssetTypePng(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_TYPE_WAV"))
-				{
-					kcppParseKAssetTypeWav(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_TYPE_OGG"))
-				{
-					kcppParseKAssetTypeOgg(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_TYPE_FLIPBOOK_META"))
-				{
-					kcppParseKAssetTypeFlipbookMeta(tokenizer, result);
-				}
-				else if(ktokeEquals(token, "KASSET_TYPE_UNKNOWN"))
-				{
-					kcppParseKAssetTypeUnknown(tokenizer, result);
-				}
-				else
-#endif// KASSET_IMPLEMENTATION
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION:
+					kcppParsePolymorphicTaggedUnion(
+						tokenizer, parsedFile, false, false);
+				break;
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION_JUMP_TABLE:
+					kcppParsePolymorphicTaggedUnion(
+						tokenizer, parsedFile, true, false);
+				break;
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION_EXTENDS:
+					kcppParsePolymorphicTaggedUnionExtension(
+						tokenizer, parsedFile, false);
+				break;
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION_EXTENDS_BOXED:
+					kcppParsePolymorphicTaggedUnionExtension(
+						tokenizer, parsedFile, true);
+				break;
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL:
+					kcppParsePolymorphicTaggedUnionPureVirtualFunctionDefinition(
+						tokenizer, parsedFile, false, false);
+				break;
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_JUMP_TABLE:
+					kcppParsePolymorphicTaggedUnionPureVirtualFunctionDefinition(
+						tokenizer, parsedFile, true, false);
+				break;
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION_ORDER_SENSITIVE:
+					kcppParsePolymorphicTaggedUnionOrderSensitive(
+						tokenizer, parsedFile);
+				break;
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION_PACKED:
+					kcppParsePolymorphicTaggedUnionPacked(
+						tokenizer, parsedFile);
+				break;
+				case KcppKeyword::POLYMORPHIC_TAGGED_UNION_PURE_VIRTUAL_OVERRIDE:
+					kcppParsePolymorphicTaggedUnionPureVirtualFunctionOverride(
+						tokenizer, parsedFile);
+				break;
+				case KcppKeyword::KASSET:
+					kcppParseKAsset(tokenizer, parsedFile);
+				break;
+				case KcppKeyword::NONE:
+				case KcppKeyword::ENUM_COUNT:
 				{
 //					result.append(token.text, token.textLength);
-				}
-			}break;
-			case KTokenType::STRING:
-			{
-//				result.push_back('"');
-//				result.append(token.text, token.textLength);
-//				result.push_back('"');
-			}break;
-			case KTokenType::CHARACTER:
-			{
-//				result.push_back('\'');
-//				result.append(token.text, token.textLength);
-//				result.push_back('\'');
-			}break;
-			default:
-			{
-//				result.append(token.text, token.textLength);
-			}break;
-			case KTokenType::END_OF_STREAM:
-			{
-				parsing = false;
-			}break;
+				}break;
+			}
+		}break;
+		case KTokenType::STRING:
+		{
+//			result.push_back('"');
+//			result.append(token.text, token.textLength);
+//			result.push_back('"');
+		}break;
+		case KTokenType::CHARACTER:
+		{
+//			result.push_back('\'');
+//			result.append(token.text, token.textLength);
+//			result.push_back('\'');
+		}break;
+		default:
+		{
+//			result.append(token.text, token.textLength);
+		}break;
+		case KTokenType::END_OF_STREAM:
+		{
+			parsing = false;
+		}break;
+	}
+	return parsing;
+}
+static void processFileData(const char* fileData, size_t fileDataSize, 
+                            ParsedFile& parsedFile)
+{
+	const char*const fileDataEnd = fileData + fileDataSize;
+	/* the vast majority of files don't contain any kcpp markers, so we can 
+		skip them without ever running the tokenizer */
+	const char* nextMarker = kprefilterFindMarker(fileData, fileDataEnd);
+	if(!nextMarker)
+		return;
+	KTokenizer tokenizer = {.at = fileData };
+	while(tokenizer.at < fileDataEnd)
+	{
+		/* once we have passed the last marker in the file, there is nothing 
+			left which can affect the output */
+		if(tokenizer.at > nextMarker)
+		{
+			nextMarker = kprefilterFindMarker(tokenizer.at, fileDataEnd);
+			if(!nextMarker)
+				break;
 		}
+		/* only run the full tokenizer on the tokens which can possibly be 
+			relevant to kcpp */
+		const char*const candidate = 
+			kprefilterNextCandidate(tokenizer.at, fileDataEnd);
+		if(!candidate)
+			break;
+		tokenizer.at = candidate;
+		const KToken token = ktokeNext(tokenizer);
+		if(!processToken(tokenizer, token, parsedFile))
+			break;
 	}
 }
 #if defined(_WIN32)
@@ -785,7 +953,7 @@ static void setFileReadOnly(const fs::path::value_type* fileName)
 #endif// defined(_WIN32)
 #endif// CLONE_FILE_TIMESTAMPS
 static bool writeEntireFile(const fs::path::value_type* fileName, 
-                            const char* nullTerminatedFileData)
+                            const char* fileData, size_t fileDataByteCount)
 {
 #if _MSC_VER
 	FILE* file = _wfopen(fileName, L"wb");
@@ -794,9 +962,8 @@ static bool writeEntireFile(const fs::path::value_type* fileName,
 #endif
 	if(file)
 	{
-		const size_t fileDataByteCount = strlen(nullTerminatedFileData);
-		const size_t bytesWritten = fwrite(nullTerminatedFileData, sizeof(char), 
-		                                   fileDataByteCount, file);
+		const size_t bytesWritten = 
+			fwrite(fileData, sizeof(char), fileDataByteCount, file);
 		if(fclose(file) != 0)
 		{
 			fprintf(stderr, "Failed to close '%ws'!\n", fileName);
@@ -852,111 +1019,622 @@ static char* readEntireFile(const fs::path::value_type* fileName,
 		return nullptr;
 	}
 }
-#if KASSET_IMPLEMENTATION
-string generateHeaderKAssets()
+/** @return true if the file at `fsPath` exists & contains exactly `fileData` */
+static bool fileContentsEqual(const fs::path& fsPath, const char* fileData, 
+                              size_t fileDataByteCount)
 {
-	string result;
-	result.append("#pragma once\n");
-	result.append("static const char* g_kassets[] = {\n");
-	if(g_kassets.empty())
+	std::error_code errorCode;
+	const uintmax_t fileSize = fs::file_size(fsPath, errorCode);
+	if(errorCode || fileSize != fileDataByteCount)
+		return false;
+#if _MSC_VER
+	FILE* file = _wfopen(fsPath.c_str(), L"rb");
+#else
+	FILE* file = fopen(fsPath.c_str(), "rb");
+#endif
+	if(!file)
+		return false;
+	/* stream the file in chunks so we can bail out at the first difference */
+	char buffer[64*1024];
+	size_t byteOffset = 0;
+	bool equal = true;
+	while(equal && byteOffset < fileDataByteCount)
 	{
-		result.append("\t\"NO_KASSETS_FOUND_IN_SOURCE!\"\n");
+		const size_t chunkSize = 
+			std::min(sizeof(buffer), fileDataByteCount - byteOffset);
+		equal = fread(buffer, sizeof(char), chunkSize, file) == chunkSize && 
+			memcmp(buffer, fileData + byteOffset, chunkSize) == 0;
+		byteOffset += chunkSize;
 	}
-	for(size_t a = 0; a < g_kassets.size(); a++)
+	fclose(file);
+	return equal;
+}
+static const char*const TEMP_FILE_EXTENSION = ".kcpp_tmp";
+/** Overwrite the file at `fsPath` with `fileData` only if the contents differ, 
+ * so that the timestamps of unchanged files are preserved & build systems 
+ * don't recompile everything which depends on them.  The data is written to 
+ * a temporary file which then replaces the destination, so other processes 
+ * can never observe a partially written file.  
+ * @return false if the file could not be written */
+static bool writeEntireFileIfChanged(const fs::path& fsPath, 
+                                     const char* fileData, 
+                                     size_t fileDataByteCount)
+{
+	if(fileContentsEqual(fsPath, fileData, fileDataByteCount))
 	{
-		const string& kasset = g_kassets[a];
-		stringstream ss;
-		ss << "\t\"" << kasset<< "\",\n";
-		result.append(ss.str());
-		const size_t fbmPostfixOffset = kasset.find(".fbm", kasset.size() - 4);
-		if(fbmPostfixOffset != string::npos)
-		{
-			// Implicitly infer that there must be a `png` file of the same file
-			//	name prefix in the same directory as the `fbm`! (for now...) //
-			const string impliedPngAssetFileName = 
-				kasset.substr(0, fbmPostfixOffset) + string(".png");
-			auto itImpliedPng = find(g_kassets.begin(), g_kassets.end(), 
-			                         impliedPngAssetFileName);
-			if(itImpliedPng == g_kassets.end())
-			{
-				g_kassets.push_back(impliedPngAssetFileName);
-			}
-		}
+		if(g_verbose)
+			printf("unchanged '%ws'\n", fsPath.c_str());
+		return true;
 	}
-	result.append("};\n");
-	result.append("enum class KAssetFileType : unsigned char {\n");
-	result.append("\tPNG,\n");
-	result.append("\tWAV,\n");
-	result.append("\tOGG,\n");
-	result.append("\tFLIPBOOK_META,\n");
-	result.append("\tUNKNOWN,\n");
-	result.append("};\n");
-	result.append("static const KAssetFileType g_kassetFileTypes[] = {\n");
-	if(g_kassets.empty())
+	fs::path fsPathTemp = fsPath;
+	fsPathTemp += TEMP_FILE_EXTENSION;
+	if(!writeEntireFile(fsPathTemp.c_str(), fileData, fileDataByteCount))
 	{
-		result.append("\tKAssetFileType::UNKNOWN\n");
+		std::error_code errorCode;
+		fs::remove(fsPathTemp, errorCode);
+		return false;
 	}
-	for(const string& kasset : g_kassets)
+	std::error_code errorCode;
+	fs::rename(fsPathTemp, fsPath, errorCode);
+	if(errorCode)
 	{
-		if(kasset.find(".png", kasset.size() - 4) != string::npos)
-		{
-			result.append("\tKAssetFileType::PNG,\n");
-		}
-		else if(kasset.find(".wav", kasset.size() - 4) != string::npos)
-		{
-			result.append("\tKAssetFileType::WAV,\n");
-		}
-		else if(kasset.find(".ogg", kasset.size() - 4) != string::npos)
-		{
-			result.append("\tKAssetFileType::OGG,\n");
-		}
-		else if(kasset.find(".fbm", kasset.size() - 4) != string::npos)
-		{
-			result.append("\tKAssetFileType::FLIPBOOK_META,\n");
-		}
-		else
-		{
-			result.append("\tKAssetFileType::UNKNOWN,\n");
-		}
+		fprintf(stderr, "Failed to replace '%ws'! error='%s'\n", 
+		        fsPath.c_str(), errorCode.message().c_str());
+		fs::remove(fsPathTemp, errorCode);
+		return false;
 	}
-	result.append("};\n");
-	result.append("static const char*const* findKAssetCStr(const char* str)\n");
-	result.append("{\n");
-	result.append("\tfor(size_t a = 0; \n"
-	              "\t    a < (sizeof(g_kassets)/sizeof(g_kassets[0])); a++)\n");
-	result.append("\t{\n");
-	result.append("\t\tif(strcmp(g_kassets[a], str) == 0)\n");
-	result.append("\t\t{\n");
-	result.append("\t\t\treturn &g_kassets[a];\n");
-	result.append("\t\t}\n");
-	result.append("\t}\n");
-	result.append("\treturn nullptr;\n");
-	result.append("}\n");
-	return result;
+	return true;
 }
-#endif// KASSET_IMPLEMENTATION
-static void printManual()
+static bool writeEntireFileIfChanged(const fs::path& fsPath, 
+                                     const string& fileData)
 {
-	printf("---KCpp: An extremely lightweight language extension to C++ ---\n");
-	printf("Usage: kcpp input_code_tree_directories generated_code_directory "
-	       "[--verbose]\n");
-	printf("@param input_code_tree_directories: A semicolon-separated list of "
-	       "directories containing C++ code which needs to be processed by "
-	       "metaprogramming routines.\n");
-#if 0
-	printf("Result: Upon successful completion, all C++ code in the input \n"
-	       "\tcode tree directory is transformed and saved into the desired \n"
-	       "\toutput directory.\n");
-	printf("Transformations: \n");
-	printf("\t-Replace `KASSET(c_str)` macros with an array index unique to \n"
-	       "\t    this c_str.\n");
-	printf("\t-Generate a file at the root of desired output directory \n"
-	       "\t    called `kasset_array.h`, which contains the accumulated \n"
-	       "\t    string data of all KASSET macro invocations in an array.\n");
-#endif// 0
+	return writeEntireFileIfChanged(fsPath, fileData.data(), fileData.size());
 }
-vector<string> 
-	split(char *phrase, string delimiter)
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif// !defined(_WIN32)
+static uintmax_t getPageSize()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	return systemInfo.dwPageSize;
+#else
+	return static_cast<uintmax_t>(sysconf(_SC_PAGESIZE));
+#endif// defined(_WIN32)
+}
+/** Map the file into memory as a read-only view.  The OS zero-fills the 
+ * remainder of the last page of the mapping, so as long as the file size is 
+ * not a multiple of the page size the view is already null-terminated & we 
+ * don't need to copy the file into our own buffer.
+ * @param inOutFileSize the size the file is expected to have, which is 
+ *                      replaced by the size of the file that was opened
+ * @return null-terminated c-string of the entire file's contents, or nullptr 
+ *         if the file can not be mapped with a null-terminator, or if its size 
+ *         differs from the expected size because it is still being written */
+static const char* mapEntireFile(const fs::path::value_type* fileName, 
+                                 uintmax_t& inOutFileSize)
+{
+	static const uintmax_t pageSize = getPageSize();
+	const uintmax_t expectedFileSize = inOutFileSize;
+#if defined(_WIN32)
+	const HANDLE hFile = 
+		CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, 
+		            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return nullptr;
+	LARGE_INTEGER openedFileSize;
+	if(!GetFileSizeEx(hFile, &openedFileSize))
+	{
+		CloseHandle(hFile);
+		return nullptr;
+	}
+	const uintmax_t fileSize = static_cast<uintmax_t>(openedFileSize.QuadPart);
+	inOutFileSize = fileSize;
+	if(fileSize != expectedFileSize || 
+		fileSize == 0 || fileSize % pageSize == 0)
+	{
+		CloseHandle(hFile);
+		return nullptr;
+	}
+	const HANDLE hMapping = 
+		CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(hFile);
+	if(!hMapping)
+		return nullptr;
+	void*const view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	/* the view keeps a reference to the mapping object */
+	CloseHandle(hMapping);
+	if(!view)
+		return nullptr;
+	WIN32_MEMORY_RANGE_ENTRY prefetchRange = 
+		{ .VirtualAddress = view
+		, .NumberOfBytes  = static_cast<SIZE_T>(fileSize) };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &prefetchRange, 0);
+	return static_cast<const char*>(view);
+#else
+	const int fd = open(fileName, O_RDONLY);
+	if(fd < 0)
+		return nullptr;
+	struct stat fileStatus;
+	if(fstat(fd, &fileStatus) != 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+	const uintmax_t fileSize = static_cast<uintmax_t>(fileStatus.st_size);
+	inOutFileSize = fileSize;
+	if(fileSize != expectedFileSize || 
+		fileSize == 0 || fileSize % pageSize == 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+	void*const view = 
+		mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	/* the mapping keeps a reference to the file */
+	close(fd);
+	if(view == MAP_FAILED)
+		return nullptr;
+	madvise(view, fileSize, MADV_SEQUENTIAL);
+	return static_cast<const char*>(view);
+#endif// defined(_WIN32)
+}
+static void unmapEntireFile(const char* fileData, uintmax_t fileSize)
+{
+#if defined(_WIN32)
+	if(!UnmapViewOfFile(fileData))
+	{
+		fprintf(stderr, "Failed to unmap view! getlasterror=%i\n", 
+		        GetLastError());
+	}
+#else
+	if(munmap(const_cast<char*>(fileData), fileSize) != 0)
+	{
+		fprintf(stderr, "Failed to unmap view!\n");
+	}
+#endif// defined(_WIN32)
+}
+/** A file which changes size between being found & being opened is read 
+ * into a heap buffer instead of being mapped, since a mapped view of it would 
+ * either lack the null-terminator or extend past the end of the file.
+ * @param inOutFileSize the size the file is expected to have, which is 
+ *                      replaced by the size of the file that was opened
+ * @return false if the file could not be read */
+static bool openInputFile(const fs::path::value_type* fileName, 
+                          uintmax_t& inOutFileSize, InputFile& outInputFile)
+{
+	outInputFile = {.data = nullptr, .size = 0, .isMapped = true};
+	outInputFile.data = mapEntireFile(fileName, inOutFileSize);
+	if(!outInputFile.data)
+	{
+		outInputFile.isMapped = false;
+		outInputFile.data     = readEntireFile(fileName, inOutFileSize);
+	}
+	outInputFile.size = inOutFileSize;
+	return outInputFile.data != nullptr;
+}
+static void closeInputFile(InputFile& inputFile)
+{
+	if(inputFile.isMapped)
+		unmapEntireFile(inputFile.data, inputFile.size);
+	else
+		free(const_cast<char*>(inputFile.data));
+	inputFile = {};
+}
+#include "cache.cpp"
+#include "profile.cpp"
+#include "kpack.cpp"
+/** Copy the text of every StringToken & KASSET of `parsedFile` into 
+ * `parsedFile.stringData`, so that they no longer refer to its source file. */
+static void copyParsedFileStrings(ParsedFile& parsedFile)
+{
+	auto forEachString = [&parsedFile](auto&& function)
+	{
+		for(PolymorphicTaggedUnionParseEvent& event : parsedFile.ptuEvents)
+		{
+			for(StringToken& token : event.functionMetaData.qualifierTokens)
+				function(token.str);
+			for(auto& param : event.functionMetaData.params)
+			{
+				function(param.identifier);
+				for(StringToken& token : param.qualifierTokens)
+					function(token.str);
+			}
+		}
+		for(string_view& kasset : parsedFile.kassets)
+			function(kasset);
+	};
+	size_t byteCount = 0;
+	forEachString([&byteCount](string_view& str) { byteCount += str.size(); });
+	if(byteCount == 0)
+		return;
+	char* stringData = static_cast<char*>(malloc(byteCount));
+	if(!stringData)
+	{
+		fprintf(stderr, "Failed to alloc %zu bytes!\n", byteCount);
+		exit(EXIT_FAILURE);
+	}
+	parsedFile.stringData = stringData;
+	forEachString([&stringData](string_view& str)
+		{
+			memcpy(stringData, str.data(), str.size());
+			str = string_view(stringData, str.size());
+			stringData += str.size();
+		});
+}
+static void freeParsedFileStrings(ParsedFile& parsedFile)
+{
+	free(parsedFile.stringData);
+	parsedFile.stringData = nullptr;
+}
+static void parseInputFile(ParsedFile& parsedFile)
+{
+	if(parsedFile.isCached)
+		return;
+	InputFile inputFile;
+	if(!openInputFile(parsedFile.path.c_str(), parsedFile.fileSize, inputFile))
+	{
+		parsedFile.readFailure = true;
+		return;
+	}
+	if(g_parseCacheEnabled)
+		parsedFile.contentHash = kcacheHash(inputFile.data, inputFile.size);
+	const ParseCacheEntry*const cacheEntry = parsedFile.cacheEntry;
+	const bool contentsCached = 
+		cacheEntry && cacheEntry->fileSize == parsedFile.fileSize && 
+		cacheEntry->contentHash == parsedFile.contentHash;
+	if(contentsCached)
+	{
+		parsedFile.ptuEvents = cacheEntry->ptuEvents;
+		parsedFile.kassets   = cacheEntry->kassets;
+	}
+	else
+	{
+		processFileData(inputFile.data, inputFile.size, parsedFile);
+		/* cached events refer to the parse cache instead */
+		copyParsedFileStrings(parsedFile);
+	}
+	/* an open file can't be saved over on Windows, so it must not outlive 
+		the parse (or --watch would keep editors from saving it) */
+	closeInputFile(inputFile);
+}
+/** Parse all `parsedFiles` using `jobCount` threads (including this one).  
+ * The files are independent of one another, so each idle thread simply claims 
+ * the next unparsed file, which keeps all threads busy until the list is 
+ * exhausted regardless of how the file sizes are distributed. */
+static void parseInputFiles(vector<ParsedFile>& parsedFiles, unsigned jobCount)
+{
+	std::atomic<size_t> nextFileIndex = 0;
+	auto parseWorker = [&parsedFiles, &nextFileIndex]()
+	{
+		for(;;)
+		{
+			const size_t f = 
+				nextFileIndex.fetch_add(1, std::memory_order_relaxed);
+			if(f >= parsedFiles.size())
+				return;
+			parseInputFile(parsedFiles[f]);
+		}
+	};
+	jobCount = static_cast<unsigned>(
+		std::min<size_t>(jobCount, std::max<size_t>(1, parsedFiles.size())));
+	vector<std::thread> threads;
+	threads.reserve(jobCount - 1);
+	for(unsigned j = 1; j < jobCount; j++)
+		threads.emplace_back(parseWorker);
+	parseWorker();
+	for(std::thread& thread : threads)
+		thread.join();
+}
+/** Emit the characters of `str` as the contents of a string literal. */
+static void kcppEmitStringLiteralContents(KEmitter& out, string_view str)
+{
+	for(const char c : str)
+	{
+		const uint8_t u = static_cast<uint8_t>(c);
+		if(c == '\\' || c == '"')
+		{
+			const char escape[2] = {'\\', c};
+			kemit(out, string_view(escape, 2));
+		}
+		else if(u < 0x20 || u == 0x7F)
+		{
+			/* always 3 digits, so the next character can't extend it */
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\%03o", u);
+			kemit(out, escape);
+		}
+		else
+			kemit(out, string_view(&c, 1));
+	}
+}
+/** Emit the comma-separated `values`, several per line. */
+static void kcppEmitUint32Table(KEmitter& out, const vector<uint32_t>& values)
+{
+	for(size_t v = 0; v < values.size(); v++)
+	{
+		char value[16];
+		snprintf(value, sizeof(value), "%u,", values[v]);
+		kemit(out, v % 8 == 0 ? "\t" : " ");
+		kemit(out, value);
+		if(v % 8 == 7 || v + 1 == values.size())
+			kemit(out, "\n");
+	}
+}
+/* Asset path lookups of the KASSET registry header, which follow its tables.  
+	`findKAssetCStr` resolves a path at runtime through the minimal perfect 
+	hash, & the full compare of the candidate rejects any path which was never 
+	registered.  In C++20, a string literal is instead converted to a 
+	`KAssetLiteral`, whose consteval constructor performs the same lookup at 
+	compile time; a literal which isn't a registered asset calls a function 
+	which isn't constexpr, so it fails to compile.  Character arrays which 
+	aren't literals must be decayed to a pointer to be searched at runtime. */
+static const char*const KASSET_LOOKUP_DEFINITION = 
+	"/* the only asset whose path can be `cStr` */\n"
+	"constexpr uint32_t kassetCandidate(const char* cStr)\n"
+	"{\n"
+	"\tconst uint64_t hash = kassetHash(cStr, KASSET_HASH_SEED);\n"
+	"\treturn g_kassetHashSlots[kassetHashSlot(hash, \n"
+	"\t\tg_kassetHashDisplacements[\n"
+	"\t\t\tkassetHashBucket(hash, KASSET_HASH_BUCKET_COUNT)], \n"
+	"\t\tsizeof(g_kassets) / sizeof(g_kassets[0]))];\n"
+	"}\n"
+	"inline const char*const* findKAssetCStr(const char* cStr)\n"
+	"{\n"
+	"\tconst uint32_t a = kassetCandidate(cStr);\n"
+	"\treturn strcmp(g_kassets[a], cStr) == 0 ? &g_kassets[a] : nullptr;\n"
+	"}\n"
+	"#if defined(__cpp_consteval)\n"
+	"constexpr bool kassetEquals(const char* a, const char* b)\n"
+	"{\n"
+	"\tfor(; *a == *b; a++, b++)\n"
+	"\t\tif(!*a)\n"
+	"\t\t\treturn true;\n"
+	"\treturn false;\n"
+	"}\n"
+	"inline void kassetLiteralIsNotARegisteredAsset() {}\n"
+	"struct KAssetLiteral\n"
+	"{\n"
+	"\tuint32_t index;\n"
+	"\ttemplate<size_t N>\n"
+	"\tconsteval KAssetLiteral(const char (&cStr)[N])\n"
+	"\t\t: index(kassetCandidate(cStr))\n"
+	"\t{\n"
+	"\t\tif(!kassetEquals(g_kassets[index], cStr))\n"
+	"\t\t\tkassetLiteralIsNotARegisteredAsset();\n"
+	"\t}\n"
+	"};\n"
+	"constexpr const char*const* kassetSearch(KAssetLiteral literal)\n"
+	"{\n"
+	"\treturn &g_kassets[literal.index];\n"
+	"}\n"
+	"template<class CStr, typename std::enable_if<!std::is_array<\n"
+	"\ttypename std::remove_reference<CStr>::type>::value, int>::type = 0>\n"
+	"inline const char*const* kassetSearch(CStr&& cStr)\n"
+	"{\n"
+	"\treturn findKAssetCStr(cStr);\n"
+	"}\n"
+	"#define KASSET(cStr) kassetSearch(KAssetLiteral(cStr))\n"
+	"#define KASSET_SEARCH(cStr) kassetSearch(cStr)\n"
+	"#else\n"
+	"#define KASSET(cStr) findKAssetCStr(cStr)\n"
+	"#define KASSET_SEARCH(cStr) findKAssetCStr(cStr)\n"
+	"#endif// defined(__cpp_consteval)\n";
+/* Locating the assets of a KASSET pack, which the program has mapped into 
+	memory.  The pack is only valid if it was written along with this header. */
+static const char*const KASSET_PACK_DEFINITION = 
+	"struct KAssetPackHeader\n"
+	"{\n"
+	"\tuint32_t magic;\n"
+	"\tuint32_t version;\n"
+	"\tuint64_t layoutHash;\n"
+	"\tuint64_t assetCount;\n"
+	"\tuint64_t byteCount;\n"
+	"};\n"
+	"struct KAssetPackEntry\n"
+	"{\n"
+	"\tuint64_t offset;\n"
+	"\tuint64_t size;\n"
+	"};\n"
+	"inline bool kassetPackIsValid(const void* pack, uint64_t packByteCount)\n"
+	"{\n"
+	"\tKAssetPackHeader header;\n"
+	"\tif(packByteCount < sizeof(header))\n"
+	"\t\treturn false;\n"
+	"\tmemcpy(&header, pack, sizeof(header));\n"
+	"\treturn header.magic      == KASSET_PACK_MAGIC && \n"
+	"\t       header.version    == KASSET_PACK_VERSION && \n"
+	"\t       header.layoutHash == KASSET_PACK_LAYOUT_HASH && \n"
+	"\t       header.byteCount  == packByteCount;\n"
+	"}\n"
+	"#define KASSET_PACK_DATA(pack, kasset) \\\n"
+	"\t(static_cast<const unsigned char*>(pack) + \\\n"
+	"\t g_kassetPack[(kasset) - g_kassets].offset)\n"
+	"#define KASSET_PACK_SIZE(kasset) g_kassetPack[(kasset) - g_kassets].size\n";
+/** Emit the description of the KASSET pack which is written by `kpackWrite`. */
+static void kcppEmitKAssetPack(KEmitter& out, const KPackLayout& layout)
+{
+	char number[64];
+	kemit(out, "#define KASSET_PACK_FILE_NAME \"");
+	kemit(out, KPACK_FILE_NAME);
+	kemit(out, "\"\nstatic constexpr uint32_t KASSET_PACK_MAGIC = ");
+	snprintf(number, sizeof(number), "0x%X", KPACK_MAGIC);
+	kemit(out, number);
+	kemit(out, ";\nstatic constexpr uint32_t KASSET_PACK_VERSION = ");
+	snprintf(number, sizeof(number), "%u", KPACK_VERSION);
+	kemit(out, number);
+	kemit(out, ";\nstatic constexpr uint64_t KASSET_PACK_ALIGNMENT = ");
+	snprintf(number, sizeof(number), "%llu", 
+	         static_cast<unsigned long long>(KPACK_ALIGNMENT));
+	kemit(out, number);
+	kemit(out, ";\nstatic constexpr uint64_t KASSET_PACK_LAYOUT_HASH = ");
+	snprintf(number, sizeof(number), "0x%llXull", 
+	         static_cast<unsigned long long>(layout.layoutHash));
+	kemit(out, number);
+	kemit(out, ";\n");
+	kemit(out, KASSET_PACK_DEFINITION);
+	kemit(out, "/* indexed by KASSET index */\n"
+	           "static constexpr KAssetPackEntry g_kassetPack[] = {\n");
+	for(const KPackAsset& asset : layout.assets)
+	{
+		snprintf(number, sizeof(number), "\t{%llu, %llu},\n", 
+		         static_cast<unsigned long long>(asset.offset), 
+		         static_cast<unsigned long long>(asset.fileSize));
+		kemit(out, number);
+	}
+	kemit(out, "};\n");
+}
+/* The KASSET registry header.  The input files are never rewritten, so the 
+	KASSET macros are defined here in terms of the registry tables.  A KASSET 
+	is a `const char*const*` into `g_kassets`.  Include this file directly 
+	wherever `INCLUDE_KASSET()` used to be.  `packLayout` is only provided if 
+	a KASSET pack is generated along with the header. */
+static void 
+	generateHeaderKAssets(KEmitter& out, const KAssetRegistry& registry, 
+	                      const KPackLayout* packLayout)
+{
+	const vector<string_view>& paths = registry.paths;
+	const KAssetPerfectHash perfectHash = kassetBuildPerfectHash(paths);
+	kemit(out, "#pragma once\n");
+	kemit(out, "#include <cstddef>\n");
+	kemit(out, "#include <cstdint>\n");
+	kemit(out, "#include <cstring>\n");
+	kemit(out, "#include <type_traits>\n");
+	/* all the tables are constexpr, so literals can be looked up at compile 
+		time */
+	kemit(out, "static constexpr const char* g_kassets[] = {\n");
+	for(const string_view path : paths)
+	{
+		kemit(out, "\t\"");
+		kcppEmitStringLiteralContents(out, path);
+		kemit(out, "\",\n");
+	}
+	kemit(out, "};\n");
+	kemit(out, "enum class KAssetFileType : unsigned char {\n");
+	for(const char*const fileTypeName : g_kassetFileTypeNames)
+	{
+		kemit(out, "\t");
+		kemit(out, fileTypeName);
+		kemit(out, ",\n");
+	}
+	kemit(out, "};\n");
+	kemit(out, "static constexpr KAssetFileType g_kassetFileTypes[] = {\n");
+	/* the registry is sorted by file type, so each type is a contiguous 
+		[begin, end) range of KASSET indices */
+	uint32_t fileTypeEnds[static_cast<size_t>(KAssetFileType::ENUM_COUNT)] = {};
+	for(const string_view path : paths)
+	{
+		const size_t fileType = static_cast<size_t>(kassetFileType(path));
+		kemit(out, "\tKAssetFileType::");
+		kemit(out, g_kassetFileTypeNames[fileType]);
+		kemit(out, ",\n");
+		fileTypeEnds[fileType]++;
+	}
+	kemit(out, "};\n");
+	kemit(out, "struct KAssetRange\n"
+	           "{\n"
+	           "\tuint32_t begin;\n"
+	           "\tuint32_t end;\n"
+	           "};\n"
+	           "/* indexed by KAssetFileType */\n"
+	           "static constexpr KAssetRange g_kassetFileTypeRanges[] = {\n");
+	uint32_t fileTypeBegin = 0;
+	for(uint32_t& fileTypeEnd : fileTypeEnds)
+	{
+		fileTypeEnd += fileTypeBegin;
+		char range[64];
+		snprintf(range, sizeof(range), "\t{%u, %u},\n", 
+		         fileTypeBegin, fileTypeEnd);
+		kemit(out, range);
+		fileTypeBegin = fileTypeEnd;
+	}
+	kemit(out, "};\n");
+	/* the minimal perfect hash of `g_kassets` */
+	char number[32];
+	kemit(out, "static constexpr uint64_t KASSET_HASH_SEED = ");
+	snprintf(number, sizeof(number), "%llu", 
+	         static_cast<unsigned long long>(perfectHash.seed));
+	kemit(out, number);
+	kemit(out, "ull;\nstatic constexpr uint32_t KASSET_HASH_BUCKET_COUNT = ");
+	snprintf(number, sizeof(number), "%zu", perfectHash.displacements.size());
+	kemit(out, number);
+	kemit(out, ";\nstatic constexpr uint32_t g_kassetHashDisplacements[] = {\n");
+	kcppEmitUint32Table(out, perfectHash.displacements);
+	kemit(out, "};\n");
+	kemit(out, "/* the index into g_kassets of the asset in each slot */\n"
+	           "static constexpr uint32_t g_kassetHashSlots[] = {\n");
+	kcppEmitUint32Table(out, perfectHash.slotAssets);
+	kemit(out, "};\n");
+	kemit(out, KASSET_HASH_DEFINITION);
+	kemit(out, KASSET_LOOKUP_DEFINITION);
+	kemit(out, 
+		"#define KASSET_CSTR(index) g_kassets[index]\n"
+		"#define KASSET_INDEX(kasset) \\\n"
+		"\tstatic_cast<uint32_t>((kasset) - g_kassets)\n"
+		"#define KASSET_TYPE(kasset) g_kassetFileTypes[(kasset) - g_kassets]\n"
+		"#define KASSET_COUNT (sizeof(g_kassets) / sizeof(g_kassets[0]))\n"
+		"#define KASSET_TYPE_RANGE(fileType) \\\n"
+		"\tg_kassetFileTypeRanges[static_cast<size_t>(fileType)]\n");
+	for(const char*const fileTypeName : g_kassetFileTypeNames)
+	{
+		kemit(out, "#define KASSET_TYPE_");
+		kemit(out, fileTypeName);
+		kemit(out, " KAssetFileType::");
+		kemit(out, fileTypeName);
+		kemit(out, "\n");
+	}
+	if(packLayout)
+		kcppEmitKAssetPack(out, *packLayout);
+}
+static void printManual()
+{
+	printf("---KCpp: An extremely lightweight language extension to C++ ---\n");
+	printf("Usage: kcpp input_code_tree_directories generated_code_directory "
+	       "[--verbose] [--jobs thread_count] [--no-cache] [--watch] "
+	       "[--layout-report] [--profile profile_file] [--instrument] "
+	       "[--kasset-pack asset_directory]\n");
+	printf("@param input_code_tree_directories: A semicolon-separated list of "
+	       "directories containing C++ code which needs to be processed by "
+	       "metaprogramming routines.\n");
+	printf("@param --jobs: The number of threads used to parse the input files. "
+	       "Defaults to the number of hardware threads.\n");
+	printf("@param --no-cache: Parse every input file, ignoring & not updating "
+	       "the parse cache stored in the generated_code_directory.\n");
+	printf("@param --watch: Keep running after the code is generated, & "
+	       "regenerate the affected files whenever an input file changes.\n");
+	printf("@param --layout-report: Generate a `<ptu>PrintLayoutReport` "
+	       "function for each PTU, which prints the bytes wasted by each "
+	       "variant of its union.\n");
+	printf("@param --profile: A type-frequency profile; lines of "
+	       "`ptu function derived_struct call_count`.  Dispatchers test the "
+	       "most frequently called types first.\n");
+	printf("@param --instrument: Count the calls of each type in every "
+	       "dispatcher, & generate `<ptu>DispatchSnapshot/Reset/Dump` "
+	       "functions.  Define KCPP_INSTRUMENT_LATENCY to also record rdtsc "
+	       "latency histograms.\n");
+	printf("@param --kasset-pack: Also generate `%s`, containing the bytes "
+	       "of every KASSET (whose paths are relative to asset_directory) "
+	       "aligned for direct use once the file is mapped into memory.\n", 
+	       KPACK_FILE_NAME);
+	printf("Benchmarks: kcpp --benchmark [input_code_tree_directories]\n");
+#if 0
+	printf("Result: Upon successful completion, all C++ code in the input \n"
+	       "\tcode tree directory is transformed and saved into the desired \n"
+	       "\toutput directory.\n");
+	printf("Transformations: \n");
+	printf("\t-Replace `KASSET(c_str)` macros with an array index unique to \n"
+	       "\t    this c_str.\n");
+	printf("\t-Generate a file at the root of desired output directory \n"
+	       "\t    called `kasset_array.h`, which contains the accumulated \n"
+	       "\t    string data of all KASSET macro invocations in an array.\n");
+#endif// 0
+}
+vector<string> 
+	split(char *phrase, string delimiter)
 {
 	/* source: https://stackoverflow.com/a/44495206/4526664 */
 	vector<string> list;
@@ -983,185 +1661,1925 @@ vector<fs::path>
 	}
 	return result;
 }
-static string 
-	toUpperCase(string str)
-{
-	std::transform(str.begin(), str.end(), str.begin(), ::toupper);
-	return str;
-}
-/**
- * @return a list of function identifiers which override `virtualFunctionId`
- */
-static vector<PolymorphicTaggedUnionPureVirtualFunctionIdentifier> 
-	kcppPolymorphicTaggedUnionPureVirtualFunctionGetFunctionOverrides(
-		const PolymorphicTaggedUnionPureVirtualFunctionIdentifier& 
-			virtualFunctionId, 
-		const PolymorphicTaggedUnionPureVirtualFunctionMetaData& 
-			virtualFunctionMeta, const string& ptuDerivedId, 
-		const map<string, 
-			map<PolymorphicTaggedUnionPureVirtualFunctionIdentifier, 
-			    PolymorphicTaggedUnionPureVirtualFunctionOverrideMetaData>>& 
-			derivedStructId_to_vFuncOverrides)
-{
-	vector<PolymorphicTaggedUnionPureVirtualFunctionIdentifier> 
-		overrideFunctionIdList;
-	for(auto derivedIt : derivedStructId_to_vFuncOverrides)
-	{
-		if(derivedIt.first != ptuDerivedId)
+static const char*const GENERATED_FILE_PREFIX = "gen_ptu_";
+static string generatedFileNameDispatch(const string& ptuId)
+{
+	return GENERATED_FILE_PREFIX + ptuId + "_dispatch.cpp";
+}
+static string generatedFileNameDispatchHeader(const string& ptuId)
+{
+	return GENERATED_FILE_PREFIX + ptuId + "_dispatch.h";
+}
+static string generatedFileNameIncludes(const string& ptuId)
+{
+	return GENERATED_FILE_PREFIX + ptuId + "_includes.h";
+}
+static string generatedFileNameUnion(const string& ptuId)
+{
+	return GENERATED_FILE_PREFIX + ptuId + ".h";
+}
+static string generatedFileNamePools(const string& ptuId)
+{
+	return GENERATED_FILE_PREFIX + ptuId + "_pools.h";
+}
+static string generatedFileNameLayout(const string& ptuId)
+{
+	return GENERATED_FILE_PREFIX + ptuId + "_layout.h";
+}
+static string generatedFileNameVisit(const string& ptuId)
+{
+	return GENERATED_FILE_PREFIX + ptuId + "_visit.h";
+}
+/** Emit the parameter declarations of `signature`, separated by commas. */
+static void 
+	kcppEmitParameterDeclarations(KEmitter& out, 
+	                              const KPtuFunctionSignature& signature)
+{
+	for(size_t p = 0; p < signature.params.size(); p++)
+	{
+		if(p > 0)
+			kemit(out, ", ");
+		for(const StringToken& st : signature.params[p].qualifierTokens)
+			kemit(out, st.str);
+	}
+}
+/** Emit the parameter identifiers of `signature` as an argument list.  
+ * @param firstArgument if not empty, replaces the first (`this`) argument */
+static void 
+	kcppEmitArguments(KEmitter& out, const KPtuFunctionSignature& signature, 
+	                  string_view firstArgument = {})
+{
+	for(size_t p = 0; p < signature.params.size(); p++)
+	{
+		if(p > 0)
+			kemit(out, ", ");
+		kemit(out, p == 0 && !firstArgument.empty() 
+			? firstArgument : signature.params[p].identifier);
+	}
+}
+/** @return true if the type tag of `ptu` is stored inside each variant; a PTU 
+ *          without any derived structs has nowhere to pack its tag */
+static bool kcppPtuIsPacked(const KPtuDatabase& db, uint32_t ptu)
+{
+	return db.ptus[ptu].packedTag && 
+		db.ptus[ptu].firstDerivedStruct != KPTU_INVALID_INDEX;
+}
+/** Emit the member of a PTU instance through which its type tag is read.  A 
+ * packed PTU's tag is read through the common initial sequence of its 
+ * variant structs, which is valid no matter which variant is active. */
+static void kcppEmitTagMember(KEmitter& out, const KPtuDatabase& db, 
+                              uint32_t ptu)
+{
+	kemit(out, kcppPtuIsPacked(db, ptu) ? "kcppTag.type" : "type");
+}
+/** Emit the member of a PTU instance which stores the derived struct `d`. */
+static void kcppEmitVariantMember(KEmitter& out, const KPtuDatabase& db, 
+                                  uint32_t d)
+{
+	const string_view derivedId = 
+		ksymbolString(db.derivedStructs[d].identifier);
+	if(kcppPtuIsPacked(db, db.derivedStructs[d].ptu))
+	{
+		kemit(out, "kcppVariant");
+		kemitTitleCase(out, derivedId);
+		kemit(out, ".");
+	}
+	kemitCamelCase(out, derivedId);
+}
+/** Emit the statements which call every override of the virtual function `v` 
+ * for the derived struct `d`, or report that there are none. */
+static void 
+	kcppEmitDispatchOverrideCalls(KEmitter& out, const KPtuDatabase& db, 
+	                              uint32_t d, uint32_t v)
+{
+	const KPtuFunctionSignature& signature = db.virtualFunctions[v].signature;
+	/* see if there is a function which overrides this function */
+	/* @TODO: compare the function signatures (function qualifiers + 
+		param qualifiers) of the overrides to verify that they match */
+	const uint32_t firstOverride = kptuFirstOverride(db, d, v);
+	for(uint32_t o = firstOverride; o != KPTU_INVALID_INDEX; 
+		o = db.functionOverrides[o].nextOverridingSameFunction)
+	{
+		kemit(out, "\t\t");
+		kemit(out, ksymbolString(db.functionOverrides[o].identifier));
+		kemit(out, "(");
+		kcppEmitArguments(out, signature);
+		kemit(out, ");\n");
+	}
+	/* If there were no functions which override this function, then we 
+		need to report this as an error!  By making this an error at 
+		runtime, we can make PTU interfaces more flexible by allowing 
+		the programmer the ability to choose NOT to override certain 
+		functions */
+	if(firstOverride == KPTU_INVALID_INDEX)
+	{
+		kemit(out, "\t\tKLOG(ERROR, \"Type(%i) does not override this "
+		           "function!\", ");
+		kemit(out, signature.params.front().identifier);
+		kemit(out, "->");
+		kcppEmitTagMember(out, db, db.derivedStructs[d].ptu);
+		kemit(out, ");\n");
+	}
+}
+/* If a type-frequency profile is loaded, the cases are ordered from the most 
+	to the least frequently dispatched type & given [[likely]]/[[unlikely]] 
+	hints (which require C++20), & a type which dominates the function's calls 
+	is tested for with an `if` before the switch. */
+static void 
+	generatePolymorphicTaggedUnionDispatchSwitch(
+		KEmitter& out, const KPtuDatabase& db, uint32_t ptu, uint32_t v, 
+		const vector<uint32_t>& derivedStructs)
+{
+	const string_view ptuIdentifier = ksymbolString(db.ptus[ptu].identifier);
+	const KPtuFunctionSignature& signature = db.virtualFunctions[v].signature;
+	const string_view thisParamId = signature.params.front().identifier;
+	/* the profiled call count of each derived struct */
+	vector<uint64_t> callCounts(derivedStructs.size(), 0);
+	uint64_t totalCallCount = 0;
+	if(g_profile.loaded)
+		for(size_t c = 0; c < derivedStructs.size(); c++)
+		{
+			callCounts[c] = kprofileCallCount(
+				db.ptus[ptu].identifier, db.virtualFunctions[v].identifier, 
+				db.derivedStructs[derivedStructs[c]].identifier);
+			totalCallCount += callCounts[c];
+		}
+	vector<size_t> caseOrder(derivedStructs.size());
+	for(size_t c = 0; c < caseOrder.size(); c++)
+		caseOrder[c] = c;
+	std::stable_sort(caseOrder.begin(), caseOrder.end(), 
+		[&callCounts](size_t a, size_t b)
+		{
+			return callCounts[a] > callCounts[b];
+		});
+	const uint64_t hottestCallCount = 
+		caseOrder.empty() ? 0 : callCounts[caseOrder.front()];
+	const bool fastPath = totalCallCount > 0 && 
+		hottestCallCount >= KPROFILE_FAST_PATH_SHARE*totalCallCount;
+	const bool likelyHottest = totalCallCount > 0 && !fastPath && 
+		hottestCallCount >= KPROFILE_LIKELY_SHARE*totalCallCount;
+	if(fastPath)
+	{
+		kemit(out, "\tif(");
+		kemit(out, thisParamId);
+		kemit(out, "->");
+		kcppEmitTagMember(out, db, ptu);
+		kemit(out, " == ");
+		kemit(out, ptuIdentifier);
+		kemit(out, "::Type::");
+		kemitUpperCase(out, ksymbolString(
+			db.derivedStructs[derivedStructs[caseOrder.front()]].identifier));
+		kemit(out, ") [[likely]]\n\t{\n");
+		kcppEmitDispatchOverrideCalls(
+			out, db, derivedStructs[caseOrder.front()], v);
+		kemit(out, "\t}\n\telse ");
+	}
+	else
+		kemit(out, "\t");
+	kemit(out, "switch(");
+	kemit(out, thisParamId);
+	kemit(out, "->");
+	kcppEmitTagMember(out, db, ptu);
+	kemit(out, ")\n");
+	kemit(out, "\t{\n");
+	for(size_t c = fastPath ? 1 : 0; c < caseOrder.size(); c++)
+	{
+		const uint32_t d = derivedStructs[caseOrder[c]];
+		kemit(out, "\t");
+		if(likelyHottest && c == 0)
+			kemit(out, "[[likely]] ");
+		else if(totalCallCount > 0 && callCounts[caseOrder[c]] == 0)
+			kemit(out, "[[unlikely]] ");
+		kemit(out, "case ");
+		kemit(out, ptuIdentifier);
+		kemit(out, "::Type::");
+		kemitUpperCase(out, ksymbolString(db.derivedStructs[d].identifier));
+		kemit(out, ":\n");
+		kcppEmitDispatchOverrideCalls(out, db, d, v);
+		kemit(out, "\tbreak;\n");
+	}
+	kemit(out, totalCallCount > 0 ? "\t[[unlikely]] case " : "\tcase ");
+	kemit(out, ptuIdentifier);
+	kemit(out, "::Type::ENUM_COUNT:\n");
+	kemit(out, "\tdefault:\n");
+	kemit(out, "\t\tKLOG(ERROR, \"Invalid type (%i)!\", ");
+	kemit(out, thisParamId);
+	kemit(out, "->");
+	kcppEmitTagMember(out, db, ptu);
+	kemit(out, ");\n");
+	kemit(out, "\tbreak;\n");
+	kemit(out, "\t}\n");
+}
+/** @return true if the function declared with `signature` returns nothing, 
+ *          in which case a batch of calls doesn't have to collect results */
+static bool kcppFunctionReturnsVoid(const KPtuFunctionSignature& signature)
+{
+	bool isVoid = false;
+	for(const StringToken& st : signature.qualifierTokens)
+		if(st.type == KTokenType::IDENTIFIER && st.str == "void")
+			isVoid = true;
+		else if(st.type != KTokenType::WHITESPACE && 
+				st.type != KTokenType::IDENTIFIER)
+			/* `void*`, etc. */
+			return false;
+	return isVoid;
+}
+/** Emit the head of a lambda with the same signature as the virtual function 
+ * `v`, so that it converts to the jump table's function pointer type. */
+static void 
+	kcppEmitJumpTableLambda(KEmitter& out, const KPtuDatabase& db, uint32_t v)
+{
+	const KPtuVirtualFunction& virtualFunction = db.virtualFunctions[v];
+	kemit(out, "[](");
+	kcppEmitParameterDeclarations(out, virtualFunction.signature);
+	kemit(out, ") -> decltype(");
+	kemit(out, ksymbolString(virtualFunction.identifier));
+	kemit(out, "(");
+	kcppEmitArguments(out, virtualFunction.signature);
+	kemit(out, "))\n");
+}
+/** Emit the body of the stub lambdas.  Like the switch, they only report the 
+ * error when the virtual function returns nothing.  Otherwise there is no 
+ * value which they could return (the function may return a reference, or a 
+ * type which can't be default constructed), so they abort. */
+static void 
+	kcppEmitJumpTableStubBody(KEmitter& out, const KPtuDatabase& db, 
+	                          uint32_t ptu, uint32_t v, string_view logFormat)
+{
+	const KPtuVirtualFunction& virtualFunction = db.virtualFunctions[v];
+	const string_view thisParamId = 
+		virtualFunction.signature.params.front().identifier;
+	kemit(out, "\t\t{\n");
+	kemit(out, "\t\t\tKLOG(ERROR, \"");
+	kemit(out, logFormat);
+	kemit(out, "\", ");
+	kemit(out, thisParamId);
+	kemit(out, "->");
+	kcppEmitTagMember(out, db, ptu);
+	kemit(out, ");\n");
+	if(!kcppFunctionReturnsVoid(virtualFunction.signature))
+		kemit(out, "\t\t\tabort();\n");
+	kemit(out, "\t\t};\n");
+}
+/* Instead of a switch, the dispatcher indexes a constant table of function 
+	pointers with the type, which compiles to a single indirect call.  Every 
+	type which doesn't override the function shares one cold stub, & the 
+	extra final entry catches invalid types without a branch. */
+static void 
+	generatePolymorphicTaggedUnionDispatchJumpTable(
+		KEmitter& out, const KPtuDatabase& db, uint32_t ptu, uint32_t v, 
+		const vector<uint32_t>& derivedStructs)
+{
+	const string_view ptuIdentifier = ksymbolString(db.ptus[ptu].identifier);
+	const KPtuFunctionSignature& signature = db.virtualFunctions[v].signature;
+	const string_view thisParamId = signature.params.front().identifier;
+	bool anyNotOverridden = false;
+	for(const uint32_t d : derivedStructs)
+		if(kptuFirstOverride(db, d, v) == KPTU_INVALID_INDEX)
+			anyNotOverridden = true;
+	kemit(out, "\tusing Function = decltype(&");
+	kemit(out, ksymbolString(db.virtualFunctions[v].identifier));
+	kemit(out, ");\n");
+	if(anyNotOverridden)
+	{
+		kemit(out, "\tstatic constexpr Function NOT_OVERRIDDEN = \n\t\t");
+		kcppEmitJumpTableLambda(out, db, v);
+		kcppEmitJumpTableStubBody(out, db, ptu, v, 
+			"Type(%i) does not override this function!");
+	}
+	kemit(out, "\tstatic constexpr Function INVALID_TYPE = \n\t\t");
+	kcppEmitJumpTableLambda(out, db, v);
+	kcppEmitJumpTableStubBody(out, db, ptu, v, "Invalid type (%i)!");
+	kemit(out, "\tstatic constexpr Function JUMP_TABLE[] = \n");
+	for(size_t ds = 0; ds < derivedStructs.size(); ds++)
+	{
+		const uint32_t d = derivedStructs[ds];
+		kemit(out, ds == 0 ? "\t\t{ " : "\t\t, ");
+		const uint32_t firstOverride = kptuFirstOverride(db, d, v);
+		if(firstOverride == KPTU_INVALID_INDEX)
+			kemit(out, "NOT_OVERRIDDEN");
+		else if(db.functionOverrides[firstOverride]
+				.nextOverridingSameFunction == KPTU_INVALID_INDEX)
+			kemit(out, 
+				ksymbolString(db.functionOverrides[firstOverride].identifier));
+		/* call each of the overrides in turn from a single entry */
+		else
+		{
+			kcppEmitJumpTableLambda(out, db, v);
+			kemit(out, "\t\t  {\n");
+			for(uint32_t o = firstOverride; o != KPTU_INVALID_INDEX; 
+				o = db.functionOverrides[o].nextOverridingSameFunction)
+			{
+				const bool last = db.functionOverrides[o]
+					.nextOverridingSameFunction == KPTU_INVALID_INDEX;
+				kemit(out, last ? "\t\t\treturn " : "\t\t\t");
+				kemit(out, ksymbolString(db.functionOverrides[o].identifier));
+				kemit(out, "(");
+				kcppEmitArguments(out, signature);
+				kemit(out, ");\n");
+			}
+			kemit(out, "\t\t  }");
+		}
+		kemit(out, "\n");
+	}
+	kemit(out, derivedStructs.empty() ? "\t\t{ " : "\t\t, ");
+	kemit(out, "INVALID_TYPE };\n");
+	kemit(out, "\tconst size_t typeIndex = static_cast<size_t>(");
+	kemit(out, thisParamId);
+	kemit(out, "->");
+	kcppEmitTagMember(out, db, ptu);
+	kemit(out, ");\n");
+	kemit(out, "\tconst size_t typeCount = static_cast<size_t>(");
+	kemit(out, ptuIdentifier);
+	kemit(out, "::Type::ENUM_COUNT);\n");
+	kemit(out, "\treturn JUMP_TABLE[typeIndex < typeCount ? typeIndex : "
+	           "typeCount](\n\t\t");
+	kcppEmitArguments(out, signature);
+	kemit(out, ");\n");
+}
+/* The shared instrumentation types are emitted into every instrumented 
+	dispatch file, so they are guarded against being defined more than once 
+	per translation unit. */
+static const char*const KCPP_INSTRUMENT_DEFINITION = 
+	"#include <atomic>\n"
+	"#include <cstddef>\n"
+	"#include <cstdint>\n"
+	"#include <cstdio>\n"
+	"#ifndef KCPP_INSTRUMENT_DEFINED\n"
+	"#define KCPP_INSTRUMENT_DEFINED\n"
+	"#ifdef KCPP_INSTRUMENT_LATENCY\n"
+	"#if defined(_MSC_VER)\n"
+	"#include <intrin.h>\n"
+	"#else\n"
+	"#include <x86intrin.h>\n"
+	"#endif\n"
+	"#endif// KCPP_INSTRUMENT_LATENCY\n"
+	"static const size_t KCPP_LATENCY_BUCKET_COUNT = 64;\n"
+	"/* the statistics of a single (function, type) pair */\n"
+	"struct KcppDispatchStats\n"
+	"{\n"
+	"\tstd::atomic<uint64_t> calls;\n"
+	"#ifdef KCPP_INSTRUMENT_LATENCY\n"
+	"\t/* bucket i counts the calls which took less than 2^i cycles, but no\n"
+	"\t\tless than 2^(i-1) */\n"
+	"\tstd::atomic<uint64_t> latencyBuckets[KCPP_LATENCY_BUCKET_COUNT];\n"
+	"#endif// KCPP_INSTRUMENT_LATENCY\n"
+	"};\n"
+	"/* counts a call when it is constructed, & records the call's latency\n"
+	"\twhen it is destroyed */\n"
+	"struct KcppDispatchScope\n"
+	"{\n"
+	"\tKcppDispatchStats& stats;\n"
+	"#ifdef KCPP_INSTRUMENT_LATENCY\n"
+	"\tconst uint64_t startCycles;\n"
+	"#endif// KCPP_INSTRUMENT_LATENCY\n"
+	"\t/* the final element of `functionStats` holds the invalid types */\n"
+	"\tKcppDispatchScope(KcppDispatchStats* functionStats, size_t typeIndex, \n"
+	"\t                  size_t typeCount)\n"
+	"\t\t: stats(functionStats[typeIndex < typeCount ? typeIndex : typeCount])\n"
+	"#ifdef KCPP_INSTRUMENT_LATENCY\n"
+	"\t\t, startCycles(__rdtsc())\n"
+	"#endif// KCPP_INSTRUMENT_LATENCY\n"
+	"\t{\n"
+	"\t\tstats.calls.fetch_add(1, std::memory_order_relaxed);\n"
+	"\t}\n"
+	"#ifdef KCPP_INSTRUMENT_LATENCY\n"
+	"\t~KcppDispatchScope()\n"
+	"\t{\n"
+	"\t\tsize_t bucket = 0;\n"
+	"\t\tfor(uint64_t cycles = __rdtsc() - startCycles; cycles; cycles >>= 1)\n"
+	"\t\t\tbucket++;\n"
+	"\t\tif(bucket >= KCPP_LATENCY_BUCKET_COUNT)\n"
+	"\t\t\tbucket = KCPP_LATENCY_BUCKET_COUNT - 1;\n"
+	"\t\tstats.latencyBuckets[bucket].fetch_add(1, std::memory_order_relaxed);\n"
+	"\t}\n"
+	"#endif// KCPP_INSTRUMENT_LATENCY\n"
+	"};\n"
+	"#endif// KCPP_INSTRUMENT_DEFINED\n";
+/** Emit the statistics of the virtual function `v` of `ptu`, which is an 
+ * array with one element per type, plus one for the invalid types. */
+static void 
+	kcppEmitInstrumentStats(KEmitter& out, const KPtuDatabase& db, 
+	                        uint32_t ptu, uint32_t v)
+{
+	const vector<uint32_t> virtualFunctions = 
+		kptuSortedVirtualFunctions(db, ptu);
+	const size_t functionIndex = 
+		std::find(virtualFunctions.begin(), virtualFunctions.end(), v) - 
+		virtualFunctions.begin();
+	char functionIndexStr[32];
+	snprintf(functionIndexStr, sizeof(functionIndexStr), "%zu", functionIndex);
+	kemit(out, "g_kcpp");
+	kemit(out, ksymbolString(db.ptus[ptu].identifier));
+	kemit(out, "DispatchStats[");
+	kemit(out, functionIndexStr);
+	kemit(out, "]");
+}
+/* With `--instrument`, the statistics of every (function, type) pair of a PTU 
+	are stored in the dispatch file, where every dispatcher counts its calls; 
+	defining KCPP_INSTRUMENT_LATENCY additionally records a histogram of the 
+	cycles spent in each call.  Each PTU gets functions which snapshot, reset 
+	& dump its statistics, which are declared in the dispatch header; the dump 
+	is a valid `--profile` file. */
+static void 
+	kcppEmitInstrumentDimensions(KEmitter& out, const KPtuDatabase& db, 
+	                             uint32_t ptu)
+{
+	char dimensions[64];
+	snprintf(dimensions, sizeof(dimensions), "[%zu][%zu]", 
+	         std::max<size_t>(kptuSortedVirtualFunctions(db, ptu).size(), 1), 
+	         kptuSortedDerivedStructs(db, ptu).size() + 1);
+	kemit(out, dimensions);
+}
+static void 
+	generatePolymorphicTaggedUnionInstrumentTables(
+		KEmitter& out, const KPtuDatabase& db, uint32_t ptu)
+{
+	const string_view ptuId = ksymbolString(db.ptus[ptu].identifier);
+	kemit(out, KCPP_INSTRUMENT_DEFINITION);
+	/* the snapshot type is declared in the dispatch header */
+	kemit(out, "#include \"");
+	kemit(out, generatedFileNameDispatchHeader(string(ptuId)));
+	kemit(out, "\"\n");
+	kemit(out, "static KcppDispatchStats g_kcpp");
+	kemit(out, ptuId);
+	kemit(out, "DispatchStats");
+	kcppEmitInstrumentDimensions(out, db, ptu);
+	kemit(out, ";\n");
+}
+/** Emit the declarations of the functions which snapshot, reset & dump the 
+ * statistics of `ptu`, & the snapshot type. */
+static void 
+	kcppEmitInstrumentApiDeclarations(KEmitter& out, const KPtuDatabase& db, 
+	                                  uint32_t ptu)
+{
+	const string_view ptuId = ksymbolString(db.ptus[ptu].identifier);
+	kemit(out, "#include <cstdint>\n");
+	kemit(out, "#include <cstdio>\n");
+	kemit(out, "/* the number of calls of each (function, type) pair; the "
+	           "final type counts\n\tthe calls of invalid types */\n");
+	kemit(out, "struct ");
+	kemit(out, ptuId);
+	kemit(out, "DispatchSnapshot\n{\n\tuint64_t calls");
+	kcppEmitInstrumentDimensions(out, db, ptu);
+	kemit(out, ";\n};\n");
+	kemit(out, "void ");
+	kemitCamelCase(out, ptuId);
+	kemit(out, "DispatchSnapshot(");
+	kemit(out, ptuId);
+	kemit(out, "DispatchSnapshot* outSnapshot);\n");
+	kemit(out, "void ");
+	kemitCamelCase(out, ptuId);
+	kemit(out, "DispatchReset();\n");
+	kemit(out, "void ");
+	kemitCamelCase(out, ptuId);
+	kemit(out, "DispatchDump(FILE* file);\n");
+}
+static void 
+	generatePolymorphicTaggedUnionInstrumentApi(
+		KEmitter& out, const KPtuDatabase& db, uint32_t ptu, 
+		const vector<uint32_t>& derivedStructs)
+{
+	const string_view ptuId = ksymbolString(db.ptus[ptu].identifier);
+	const vector<uint32_t> virtualFunctions = 
+		kptuSortedVirtualFunctions(db, ptu);
+	/* snapshot */
+	kemit(out, "void ");
+	kemitCamelCase(out, ptuId);
+	kemit(out, "DispatchSnapshot(");
+	kemit(out, ptuId);
+	kemit(out, "DispatchSnapshot* outSnapshot)\n{\n");
+	kemit(out, "\tfor(size_t f = 0; f < sizeof(outSnapshot->calls) / "
+	           "sizeof(outSnapshot->calls[0]); f++)\n");
+	kemit(out, "\t\tfor(size_t t = 0; t < sizeof(outSnapshot->calls[0]) / "
+	           "sizeof(uint64_t); t++)\n");
+	kemit(out, "\t\t\toutSnapshot->calls[f][t] = g_kcpp");
+	kemit(out, ptuId);
+	kemit(out, "DispatchStats[f][t].calls.load(\n");
+	kemit(out, "\t\t\t\tstd::memory_order_relaxed);\n}\n");
+	/* reset */
+	kemit(out, "void ");
+	kemitCamelCase(out, ptuId);
+	kemit(out, "DispatchReset()\n{\n");
+	kemit(out, "\tfor(auto& functionStats : g_kcpp");
+	kemit(out, ptuId);
+	kemit(out, "DispatchStats)\n");
+	kemit(out, "\t\tfor(KcppDispatchStats& stats : functionStats)\n\t\t{\n");
+	kemit(out, "\t\t\tstats.calls.store(0, std::memory_order_relaxed);\n");
+	kemit(out, "#ifdef KCPP_INSTRUMENT_LATENCY\n");
+	kemit(out, "\t\t\tfor(auto& bucket : stats.latencyBuckets)\n");
+	kemit(out, "\t\t\t\tbucket.store(0, std::memory_order_relaxed);\n");
+	kemit(out, "#endif// KCPP_INSTRUMENT_LATENCY\n");
+	kemit(out, "\t\t}\n}\n");
+	/* dump; calls of invalid types & latency histograms are comments, so 
+		that the dump can be passed straight back to `--profile` */
+	kemit(out, "void ");
+	kemitCamelCase(out, ptuId);
+	kemit(out, "DispatchDump(FILE* file)\n{\n");
+	kemit(out, "\tstatic const char*const FUNCTIONS[] = \n");
+	if(virtualFunctions.empty())
+		kemit(out, "\t\t{ \"\" };\n");
+	for(size_t f = 0; f < virtualFunctions.size(); f++)
+	{
+		kemit(out, f == 0 ? "\t\t{ \"" : "\t\t, \"");
+		kemit(out, ksymbolString(db.virtualFunctions[virtualFunctions[f]].identifier));
+		kemit(out, f + 1 == virtualFunctions.size() ? "\" };\n" : "\"\n");
+	}
+	kemit(out, "\tstatic const char*const TYPES[] = \n");
+	for(const uint32_t d : derivedStructs)
+	{
+		kemit(out, d == derivedStructs.front() ? "\t\t{ \"" : "\t\t, \"");
+		kemit(out, ksymbolString(db.derivedStructs[d].identifier));
+		kemit(out, "\"\n");
+	}
+	kemit(out, derivedStructs.empty() ? "\t\t{ nullptr };\n" : "\t\t, nullptr };\n");
+	kemit(out, "\tfor(size_t f = 0; f < sizeof(FUNCTIONS) / sizeof(FUNCTIONS[0]); "
+	           "f++)\n");
+	kemit(out, "\t\tfor(size_t t = 0; t < sizeof(TYPES) / sizeof(TYPES[0]); "
+	           "t++)\n\t\t{\n");
+	kemit(out, "\t\t\tconst KcppDispatchStats& stats = g_kcpp");
+	kemit(out, ptuId);
+	kemit(out, "DispatchStats[f][t];\n");
+	kemit(out, "\t\t\tconst uint64_t calls = "
+	           "stats.calls.load(std::memory_order_relaxed);\n");
+	kemit(out, "\t\t\tif(calls == 0)\n\t\t\t\tcontinue;\n");
+	kemit(out, "\t\t\tif(TYPES[t])\n");
+	kemit(out, "\t\t\t\tfprintf(file, \"");
+	kemit(out, ptuId);
+	kemit(out, " %s %s %llu\\n\", FUNCTIONS[f], TYPES[t], \n");
+	kemit(out, "\t\t\t\t        static_cast<unsigned long long>(calls));\n");
+	kemit(out, "\t\t\telse\n");
+	kemit(out, "\t\t\t\tfprintf(file, \"# ");
+	kemit(out, ptuId);
+	kemit(out, " %s <invalid type> %llu\\n\", FUNCTIONS[f], \n");
+	kemit(out, "\t\t\t\t        static_cast<unsigned long long>(calls));\n");
+	kemit(out, "#ifdef KCPP_INSTRUMENT_LATENCY\n");
+	kemit(out, "\t\t\tfprintf(file, \"#\\tcycles < 2^bucket:\");\n");
+	kemit(out, "\t\t\tfor(size_t b = 0; b < KCPP_LATENCY_BUCKET_COUNT; b++)\n");
+	kemit(out, "\t\t\t{\n");
+	kemit(out, "\t\t\t\tconst uint64_t bucketCalls = \n");
+	kemit(out, "\t\t\t\t\tstats.latencyBuckets[b].load("
+	           "std::memory_order_relaxed);\n");
+	kemit(out, "\t\t\t\tif(bucketCalls)\n");
+	kemit(out, "\t\t\t\t\tfprintf(file, \" %zu:%llu\", b, \n");
+	kemit(out, "\t\t\t\t\t        static_cast<unsigned long long>(bucketCalls));\n");
+	kemit(out, "\t\t\t}\n");
+	kemit(out, "\t\t\tfprintf(file, \"\\n\");\n");
+	kemit(out, "#endif// KCPP_INSTRUMENT_LATENCY\n");
+	kemit(out, "\t\t}\n}\n");
+}
+/* The batch entry point of a pure virtual function calls it for an array of 
+	instances.  Each chunk of instances is binned by type with a stable 
+	counting sort, and then each override is called in a tight loop over the 
+	instances of a single type, so the calls are direct & predictable. */
+static const size_t KCPP_BATCH_CHUNK_SIZE = 256;
+static_assert(KCPP_BATCH_CHUNK_SIZE <= 256, 
+	"batch chunk indices are stored as `unsigned char`s!");
+/** Emit the declarator of the batch entry point of the virtual function `v`, 
+ * which takes the number of instances after the array of instances. */
+static void 
+	kcppEmitBatchDeclarator(KEmitter& out, const KPtuDatabase& db, uint32_t v)
+{
+	const KPtuFunctionSignature& signature = db.virtualFunctions[v].signature;
+	for(const StringToken& sTokeQualifier : signature.qualifierTokens)
+		kemit(out, sTokeQualifier.str);
+	kemit(out, ksymbolString(db.virtualFunctions[v].identifier));
+	kemit(out, "Batch(\n\t\t");
+	for(size_t p = 0; p < signature.params.size(); p++)
+	{
+		if(p > 0)
+			kemit(out, ", ");
+		for(const StringToken& st : signature.params[p].qualifierTokens)
+			kemit(out, st.str);
+		if(p == 0)
+			kemit(out, ", size_t kcppCount");
+	}
+	kemit(out, ")");
+}
+static void 
+	generatePolymorphicTaggedUnionDispatchBatch(
+		KEmitter& out, const KPtuDatabase& db, uint32_t ptu, uint32_t v, 
+		const vector<uint32_t>& derivedStructs)
+{
+	const string_view ptuIdentifier = ksymbolString(db.ptus[ptu].identifier);
+	const KPtuVirtualFunction& virtualFunction = db.virtualFunctions[v];
+	const KPtuFunctionSignature& signature = virtualFunction.signature;
+	const string_view functionId = ksymbolString(virtualFunction.identifier);
+	const string_view thisParamId = signature.params.front().identifier;
+	kcppEmitBatchDeclarator(out, db, v);
+	kemit(out, "\n");
+	kemit(out, "{\n");
+	if(virtualFunction.orderSensitive)
+	{
+		kemit(out, "\t/* order-sensitive; dispatch each instance in order */\n");
+		kemit(out, "\tfor(size_t kcppI = 0; kcppI < kcppCount; kcppI++)\n");
+		kemit(out, "\t\t");
+		kemit(out, functionId);
+		kemit(out, "(");
+		kcppEmitArguments(out, signature, "&" + string(thisParamId) + 
+		                  "[kcppI]");
+		kemit(out, ");\n");
+		kemit(out, "}\n");
+		return;
+	}
+	const string instanceArgument = 
+		"&kcppInstances[kcppSorted[kcppS]]";
+	char chunkSize[32];
+	snprintf(chunkSize, sizeof(chunkSize), "%zu", KCPP_BATCH_CHUNK_SIZE);
+	kemit(out, "\t/* bin i holds the instances of type i; the final bin holds "
+	           "any invalid types */\n");
+	kemit(out, "\tconstexpr size_t kcppBinCount = static_cast<size_t>(");
+	kemit(out, ptuIdentifier);
+	kemit(out, "::Type::ENUM_COUNT) + 1;\n");
+	kemit(out, "\tfor(size_t kcppChunk = 0; kcppChunk < kcppCount; "
+	           "kcppChunk += ");
+	kemit(out, chunkSize);
+	kemit(out, ")\n");
+	kemit(out, "\t{\n");
+	kemit(out, "\t\tconst auto kcppInstances = ");
+	kemit(out, thisParamId);
+	kemit(out, " + kcppChunk;\n");
+	kemit(out, "\t\tconst size_t kcppChunkCount = kcppCount - kcppChunk < ");
+	kemit(out, chunkSize);
+	kemit(out, " ? kcppCount - kcppChunk : ");
+	kemit(out, chunkSize);
+	kemit(out, ";\n");
+	kemit(out, "\t\tsize_t kcppBinEnds[kcppBinCount] = {};\n");
+	kemit(out, "\t\tfor(size_t kcppI = 0; kcppI < kcppChunkCount; kcppI++)\n");
+	kemit(out, "\t\t{\n");
+	kemit(out, "\t\t\tconst size_t kcppBin = "
+	           "static_cast<size_t>(kcppInstances[kcppI].");
+	kcppEmitTagMember(out, db, ptu);
+	kemit(out, ");\n");
+	kemit(out, "\t\t\tkcppBinEnds[kcppBin < kcppBinCount ? kcppBin : "
+	           "kcppBinCount - 1]++;\n");
+	kemit(out, "\t\t}\n");
+	kemit(out, "\t\tfor(size_t kcppB = 0, kcppStart = 0; kcppB < kcppBinCount; "
+	           "kcppB++)\n");
+	kemit(out, "\t\t{\n");
+	kemit(out, "\t\t\tconst size_t kcppBinSize = kcppBinEnds[kcppB];\n");
+	kemit(out, "\t\t\tkcppBinEnds[kcppB] = kcppStart;\n");
+	kemit(out, "\t\t\tkcppStart += kcppBinSize;\n");
+	kemit(out, "\t\t}\n");
+	kemit(out, "\t\tunsigned char kcppSorted[");
+	kemit(out, chunkSize);
+	kemit(out, "];\n");
+	kemit(out, "\t\tfor(size_t kcppI = 0; kcppI < kcppChunkCount; kcppI++)\n");
+	kemit(out, "\t\t{\n");
+	kemit(out, "\t\t\tconst size_t kcppBin = "
+	           "static_cast<size_t>(kcppInstances[kcppI].");
+	kcppEmitTagMember(out, db, ptu);
+	kemit(out, ");\n");
+	kemit(out, "\t\t\tkcppSorted[kcppBinEnds[kcppBin < kcppBinCount ? kcppBin "
+	           ": kcppBinCount - 1]++] = \n");
+	kemit(out, "\t\t\t\tstatic_cast<unsigned char>(kcppI);\n");
+	kemit(out, "\t\t}\n");
+	/* after the scatter, kcppBinEnds[b] is where bin b ends & bin b + 1 
+		begins */
+	for(size_t ds = 0; ds <= derivedStructs.size(); ds++)
+	{
+		char binRange[128];
+		if(ds == 0)
+			snprintf(binRange, sizeof(binRange), 
+			         "size_t kcppS = 0; kcppS < kcppBinEnds[0]; kcppS++");
+		else
+			snprintf(binRange, sizeof(binRange), 
+			         "size_t kcppS = kcppBinEnds[%zu]; kcppS < kcppBinEnds[%zu]; "
+			         "kcppS++", ds - 1, ds);
+		/* types which don't override the function (& invalid types) go 
+			through the single-instance dispatcher, which reports them */
+		const uint32_t firstOverride = ds < derivedStructs.size() 
+			? kptuFirstOverride(db, derivedStructs[ds], v) 
+			: KPTU_INVALID_INDEX;
+		if(firstOverride == KPTU_INVALID_INDEX)
+		{
+			kemit(out, "\t\tfor(");
+			kemit(out, binRange);
+			kemit(out, ")\n");
+			kemit(out, "\t\t\t");
+			kemit(out, functionId);
+			kemit(out, "(");
+			kcppEmitArguments(out, signature, instanceArgument);
+			kemit(out, ");\n");
 			continue;
-		for(auto overrideIt : derivedIt.second)
-		{
-			if(overrideIt.second.superFunctionIdentifier == virtualFunctionId)
-				overrideFunctionIdList.push_back(overrideIt.first);
-			/* iterate over all of the vFuncOverrides, and compare all their 
-				function signatures (function qualifiers + param qualifiers) to 
-				verify that they match */
-			// @TODO
 		}
+		/* the calls to overrides bypass the dispatcher, so they have to be 
+			counted here */
+		if(g_instrument)
+		{
+			char binSize[96];
+			snprintf(binSize, sizeof(binSize), ds == 0 
+			         ? "kcppBinEnds[0]" 
+			         : "kcppBinEnds[%zu] - kcppBinEnds[%zu]", ds, ds - 1);
+			kemit(out, "\t\t");
+			kcppEmitInstrumentStats(out, db, ptu, v);
+			kemit(out, "[");
+			kemit(out, std::to_string(ds));
+			kemit(out, "].calls.fetch_add(\n\t\t\t");
+			kemit(out, binSize);
+			kemit(out, ", std::memory_order_relaxed);\n");
+		}
+		kemit(out, "\t\tfor(");
+		kemit(out, binRange);
+		kemit(out, ")\n");
+		kemit(out, "\t\t{\n");
+		for(uint32_t o = firstOverride; o != KPTU_INVALID_INDEX; 
+			o = db.functionOverrides[o].nextOverridingSameFunction)
+		{
+			kemit(out, "\t\t\t");
+			kemit(out, ksymbolString(db.functionOverrides[o].identifier));
+			kemit(out, "(");
+			kcppEmitArguments(out, signature, instanceArgument);
+			kemit(out, ");\n");
+		}
+		kemit(out, "\t\t}\n");
 	}
-	return overrideFunctionIdList;
+	kemit(out, "\t}\n");
+	kemit(out, "}\n");
 }
-static string 
-	generatePolymorphicTaggedUnionDispatch(
-		const string& ptuIdentifier, 
-		const PolymorphicTaggedUnionMetaData& ptuMeta)
+static void 
+	generatePolymorphicTaggedUnionDispatch(KEmitter& out, 
+	                                       const KPtuDatabase& db, uint32_t ptu)
 {
-	string result;
+	const vector<uint32_t> derivedStructs = kptuSortedDerivedStructs(db, ptu);
+	/* the stubs of the jump tables abort */
+	bool anyJumpTable = db.ptus[ptu].jumpTableDispatch;
+	for(const uint32_t v : kptuSortedVirtualFunctions(db, ptu))
+		if(db.virtualFunctions[v].jumpTableDispatch)
+			anyJumpTable = true;
+	if(anyJumpTable)
+		kemit(out, "#include <cstdlib>\n");
+	if(g_instrument)
+		generatePolymorphicTaggedUnionInstrumentTables(out, db, ptu);
 	/* iterate over each pure virtual function and construct a function 
 		definition which switches on the generated Type of the first parameter 
 		and calls any overridden versions */
-	for(auto vfIt : ptuMeta.virtualFunctions)
+	for(const uint32_t v : kptuSortedVirtualFunctions(db, ptu))
 	{
-		for(const StringToken& sTokeQualifier : vfIt.second.qualifierTokens)
+		const KPtuVirtualFunction& virtualFunction = db.virtualFunctions[v];
+		const KPtuFunctionSignature& signature = virtualFunction.signature;
+		for(const StringToken& sTokeQualifier : signature.qualifierTokens)
+			kemit(out, sTokeQualifier.str);
+		kemit(out, ksymbolString(virtualFunction.identifier));
+		kemit(out, "(\n\t\t");
+		kcppEmitParameterDeclarations(out, signature);
+		kemit(out, ")\n");
+		kemit(out, "{\n");
+		assert(!signature.params.empty());
+		if(g_instrument)
 		{
-			result.append(sTokeQualifier.str);
-		}
-		result.append(vfIt.first);
-		result.append("(\n\t\t");
-		for(size_t p = 0; p < vfIt.second.params.size(); p++)
-		{
-			const PolymorphicTaggedUnionPureVirtualFunctionMetaData::Parameter& 
-				param = vfIt.second.params[p];
-			if(p > 0)
-				result.append(", ");
-			for(const StringToken& st : param.qualifierTokens)
-				result.append(st.str);
-		}
-		result.append(")\n");
-		result.append("{\n");
-		assert(!vfIt.second.params.empty());
-		const string thisParamId = vfIt.second.params.front().identifier;
-		result.append("\tswitch("+thisParamId+"->type)\n");
-		result.append("\t{\n");
-		for(auto derivedIt : ptuMeta.derivedStructId_to_vFuncOverrides)
-		{
-			const string& ptuDerivedId = derivedIt.first;
-			result.append(
-				"\tcase " + ptuIdentifier + "::Type::"
-					+ toUpperCase(ptuDerivedId)+":\n");
-			/* see if there is a function which overrides this function */
-			vector<PolymorphicTaggedUnionPureVirtualFunctionIdentifier> 
-					overrideFunctionIds = 
-						kcppPolymorphicTaggedUnionPureVirtualFunctionGetFunctionOverrides(
-							vfIt.first, vfIt.second, ptuDerivedId, 
-							ptuMeta.derivedStructId_to_vFuncOverrides);
-			for(const auto& derivedFunctionId : overrideFunctionIds)
-			{
-				result.append("\t\t"+derivedFunctionId+"(");
-				for(size_t p = 0; p < vfIt.second.params.size(); p++)
-				{
-					const PolymorphicTaggedUnionPureVirtualFunctionMetaData::
-							Parameter& 
-						param = vfIt.second.params[p];
-					if(p > 0)
-						result.append(", ");
-					result.append(param.identifier);
-				}
-				result.append(");\n");
-			}
-			/* If there were no functions which override this function, then we 
-				need to report this as an error!  By making this an error at 
-				runtime, we can make PTU interfaces more flexible by allowing 
-				the programmer the ability to choose NOT to override certain 
-				functions */
-			if(overrideFunctionIds.empty())
-				result.append(
-					"\t\tKLOG(ERROR, \"Type(%i) does not override this "
-						"function!\", " 
-					+ thisParamId + "->type);\n");
-			result.append("\tbreak;\n");
+			kemit(out, "\tKcppDispatchScope kcppScope(");
+			kcppEmitInstrumentStats(out, db, ptu, v);
+			kemit(out, ", \n\t\tstatic_cast<size_t>(");
+			kemit(out, signature.params.front().identifier);
+			kemit(out, "->");
+			kcppEmitTagMember(out, db, ptu);
+			kemit(out, "), static_cast<size_t>(");
+			kemit(out, ksymbolString(db.ptus[ptu].identifier));
+			kemit(out, "::Type::ENUM_COUNT));\n");
 		}
-		result.append("\tcase "+ptuIdentifier+"::Type::ENUM_COUNT:\n");
-		result.append("\tdefault:\n");
-		result.append("\t\tKLOG(ERROR, \"Invalid type (%i)!\", "+
-		              thisParamId+"->type);\n");
-		result.append("\tbreak;\n");
-		result.append("\t}\n");
-		result.append("}\n");
+		if(db.ptus[ptu].jumpTableDispatch || virtualFunction.jumpTableDispatch)
+			generatePolymorphicTaggedUnionDispatchJumpTable(
+				out, db, ptu, v, derivedStructs);
+		else
+			generatePolymorphicTaggedUnionDispatchSwitch(
+				out, db, ptu, v, derivedStructs);
+		kemit(out, "}\n");
+		if(kcppFunctionReturnsVoid(signature))
+			generatePolymorphicTaggedUnionDispatchBatch(
+				out, db, ptu, v, derivedStructs);
 	}
-	return result;
+	if(g_instrument)
+		generatePolymorphicTaggedUnionInstrumentApi(
+			out, db, ptu, derivedStructs);
 }
-static string 
-	generatePolymorphicTaggedUnionIncludes(
-		const string& ptuIdentifier, 
-		const PolymorphicTaggedUnionMetaData& ptuMeta)
+/* The dispatch header declares the functions which kcpp defines in the 
+	dispatch file, so that they can be called from other files: the batch 
+	entry point `<function>Batch(instances, count, ...)` of every pure virtual 
+	function which returns void, & with `--instrument` the functions which 
+	snapshot, reset & dump the dispatch statistics.  The file must be included 
+	after the declarations of the pure virtual functions. */
+static void 
+	generatePolymorphicTaggedUnionDispatchHeader(KEmitter& out, 
+	                                             const KPtuDatabase& db, 
+	                                             uint32_t ptu)
 {
-	string result;
-	result.append("#pragma once\n");
-	for(auto derivedIt : ptuMeta.derivedStructId_to_vFuncOverrides)
+	kemit(out, "#pragma once\n");
+	kemit(out, "#include <cstddef>\n");
+	for(const uint32_t v : kptuSortedVirtualFunctions(db, ptu))
 	{
-		const string& ptuDerivedId = derivedIt.first;
-		string ptuDerivedIdCamelCase = ptuDerivedId;
-		ptuDerivedIdCamelCase[0] = tolower(ptuDerivedId[0]);
-		result.append("#include \"" + ptuDerivedIdCamelCase + ".h\"\n");
+		if(!kcppFunctionReturnsVoid(db.virtualFunctions[v].signature))
+			continue;
+		kcppEmitBatchDeclarator(out, db, v);
+		kemit(out, ";\n");
 	}
-	return result;
+	if(g_instrument)
+		kcppEmitInstrumentApiDeclarations(out, db, ptu);
+}
+static void 
+	generatePolymorphicTaggedUnionIncludes(KEmitter& out, 
+	                                       const KPtuDatabase& db, uint32_t ptu)
+{
+	kemit(out, "#pragma once\n");
+	for(const uint32_t d : kptuSortedDerivedStructs(db, ptu))
+	{
+		kemit(out, "#include \"");
+		kemitCamelCase(out, ksymbolString(db.derivedStructs[d].identifier));
+		kemit(out, ".h\"\n");
+	}
+}
+/** Emit the type which `derivedStruct` is stored as inside its PTU's union; 
+ * boxed derived structs are stored as a pointer to their out-of-line 
+ * instance, so they don't have to be complete types where the PTU is. */
+static void kcppEmitUnionMemberType(KEmitter& out, 
+                                    const KPtuDerivedStruct& derivedStruct)
+{
+	kemitTitleCase(out, ksymbolString(derivedStruct.identifier));
+	if(derivedStruct.boxed)
+		kemit(out, "*");
 }
-static string 
-	generatePolymorphicTaggedUnion(
-		const string& ptuIdentifier, 
-		const PolymorphicTaggedUnionMetaData& ptuMeta)
+/** Emit one union member declaration per derived struct, each on its own 
+ * line which begins with `indent`. */
+static void kcppEmitUnionMembers(KEmitter& out, const KPtuDatabase& db, 
+                                 const vector<uint32_t>& derivedStructs, 
+                                 string_view indent)
 {
-	string result;
+	for(const uint32_t d : derivedStructs)
+	{
+		kemit(out, indent);
+		kcppEmitUnionMemberType(out, db.derivedStructs[d]);
+		kemit(out, " ");
+		kemitCamelCase(out, ksymbolString(db.derivedStructs[d].identifier));
+		kemit(out, ";\n");
+	}
+}
+/** @return the narrowest underlying type of a PTU's type enum which can hold 
+ *          every derived struct as well as ENUM_COUNT */
+static string_view kcppTagType(size_t derivedStructCount)
+{
+	if(derivedStructCount <= 0xFF)
+		return "u8";
+	if(derivedStructCount <= 0xFFFF)
+		return "u16";
+	return "u32";
+}
+/* A packed PTU stores each variant in a struct which begins with its own 
+	copy of the type tag, so the tag only costs the padding before the 
+	variant's payload.  The union also contains a struct of only the tag; all 
+	of these structs share the tag as their common initial sequence, so the 
+	tag can be read through `kcppTag` no matter which variant is active.  The 
+	payloads are accessed through the functions of the layout file. */
+static void 
+	generatePolymorphicTaggedUnion(KEmitter& out, 
+	                               const KPtuDatabase& db, uint32_t ptu)
+{
+	const vector<uint32_t> derivedStructs = kptuSortedDerivedStructs(db, ptu);
+	const bool packedTag = kcppPtuIsPacked(db, ptu);
 	/* generate a type enumeration for the tagged union */
-	result.append("enum class Type : u16\n");
-	result.append("	{ ");
+	kemit(out, "enum class Type : ");
+	kemit(out, kcppTagType(derivedStructs.size()));
+	kemit(out, "\n");
+	kemit(out, "	{ ");
 	bool firstEnum = true;
-	for(auto derivedIt : ptuMeta.derivedStructId_to_vFuncOverrides)
+	for(const uint32_t d : derivedStructs)
 	{
-		const string& ptuDerivedId = derivedIt.first;
 		if(!firstEnum)
-			result.append("\n	, ");
+			kemit(out, "\n	, ");
 		firstEnum = false;
-		result.append(toUpperCase(ptuDerivedId));
+		kemitUpperCase(out, ksymbolString(db.derivedStructs[d].identifier));
+	}
+	if(!derivedStructs.empty())
+		kemit(out, "\n	, ");
+	if(packedTag)
+	{
+		kemit(out, "ENUM_COUNT };\n");
+		kemit(out, "struct KcppTag\n{\n	Type type;\n};\n");
+		for(const uint32_t d : derivedStructs)
+		{
+			const string_view ptuDerivedId = 
+				ksymbolString(db.derivedStructs[d].identifier);
+			kemit(out, "struct KcppVariant");
+			kemitTitleCase(out, ptuDerivedId);
+			kemit(out, "\n{\n	Type type;\n	");
+			kcppEmitUnionMemberType(out, db.derivedStructs[d]);
+			kemit(out, " ");
+			kemitCamelCase(out, ptuDerivedId);
+			kemit(out, ";\n};\n");
+		}
+		kemit(out, "union\n");
+		kemit(out, "{\n");
+		kemit(out, "	KcppTag kcppTag;\n");
+		for(const uint32_t d : derivedStructs)
+		{
+			const string_view ptuDerivedId = 
+				ksymbolString(db.derivedStructs[d].identifier);
+			kemit(out, "	KcppVariant");
+			kemitTitleCase(out, ptuDerivedId);
+			kemit(out, " kcppVariant");
+			kemitTitleCase(out, ptuDerivedId);
+			kemit(out, ";\n");
+		}
+		kemit(out, "};\n");
+		return;
 	}
-	if(!ptuMeta.derivedStructId_to_vFuncOverrides.empty())
-		result.append("\n	, ");
 	/* declare a member variable of the struct with this type enum! */
-	result.append("ENUM_COUNT } type;\n");
+	kemit(out, "ENUM_COUNT } type;\n");
 	/* generate the union of derived structs */
-	result.append("union\n");
-	result.append("{\n");
-	if(ptuMeta.derivedStructId_to_vFuncOverrides.empty())
-		result.append("	void* no_derived_structs;\n");
+	kemit(out, "union\n");
+	kemit(out, "{\n");
+	if(derivedStructs.empty())
+		kemit(out, "	void* no_derived_structs;\n");
 	else
-		for(auto derivedIt : ptuMeta.derivedStructId_to_vFuncOverrides)
-		{
-			const string& ptuDerivedId = derivedIt.first;
-			string ptuDerivedIdTitleCase = ptuDerivedId;
-			string ptuDerivedIdCamelCase = ptuDerivedId;
-			ptuDerivedIdTitleCase[0] = toupper(ptuDerivedId[0]);
-			ptuDerivedIdCamelCase[0] = tolower(ptuDerivedId[0]);
-			result.append("	" + ptuDerivedIdTitleCase + " " + 
-			              ptuDerivedIdCamelCase + ";\n");
+		kcppEmitUnionMembers(out, db, derivedStructs, "\t");
+	kemit(out, "};\n");
+}
+/* The shared pool container is emitted into every pools file, so it is 
+	guarded against being defined more than once per translation unit. */
+static const char*const KCPP_POOL_DEFINITION = 
+	"#ifndef KCPP_POOL_DEFINED\n"
+	"#define KCPP_POOL_DEFINED\n"
+	"/* A contiguous pool of instances.  Erasing an instance moves the last\n"
+	"\tinstance into its place, so instances are referred to by slot, which\n"
+	"\tnever moves.  A slot's generation changes whenever its instance is\n"
+	"\terased, which invalidates all the old handles to it. */\n"
+	"template<class T>\n"
+	"struct KcppPool\n"
+	"{\n"
+	"\tstd::vector<T> instances;\n"
+	"\t/* instance index -> slot */\n"
+	"\tstd::vector<uint32_t> instanceSlots;\n"
+	"\t/* slot -> instance index, or the next free slot if the slot is free */\n"
+	"\tstd::vector<uint32_t> slotInstances;\n"
+	"\tstd::vector<uint32_t> slotGenerations;\n"
+	"\tuint32_t firstFreeSlot = ~0u;\n"
+	"};\n"
+	"template<class T>\n"
+	"inline uint32_t kcppPoolInsert(KcppPool<T>& pool, const T& instance)\n"
+	"{\n"
+	"\tuint32_t slot = pool.firstFreeSlot;\n"
+	"\tif(slot == ~0u)\n"
+	"\t{\n"
+	"\t\tslot = static_cast<uint32_t>(pool.slotInstances.size());\n"
+	"\t\tpool.slotInstances.push_back(0);\n"
+	"\t\tpool.slotGenerations.push_back(0);\n"
+	"\t}\n"
+	"\telse\n"
+	"\t\tpool.firstFreeSlot = pool.slotInstances[slot];\n"
+	"\tpool.slotInstances[slot] = static_cast<uint32_t>(pool.instances.size());\n"
+	"\tpool.instances.push_back(instance);\n"
+	"\tpool.instanceSlots.push_back(slot);\n"
+	"\treturn slot;\n"
+	"}\n"
+	"template<class T>\n"
+	"inline T* kcppPoolGet(KcppPool<T>& pool, uint32_t slot, "
+		"uint32_t generation)\n"
+	"{\n"
+	"\tif(slot >= pool.slotGenerations.size() || \n"
+	"\t\tpool.slotGenerations[slot] != generation)\n"
+	"\t\treturn nullptr;\n"
+	"\treturn &pool.instances[pool.slotInstances[slot]];\n"
+	"}\n"
+	"template<class T>\n"
+	"inline bool kcppPoolErase(KcppPool<T>& pool, uint32_t slot, "
+		"uint32_t generation)\n"
+	"{\n"
+	"\tif(!kcppPoolGet(pool, slot, generation))\n"
+	"\t\treturn false;\n"
+	"\tconst uint32_t index = pool.slotInstances[slot];\n"
+	"\tconst uint32_t lastIndex = "
+		"static_cast<uint32_t>(pool.instances.size()) - 1;\n"
+	"\tif(index != lastIndex)\n"
+	"\t{\n"
+	"\t\tpool.instances[index] = std::move(pool.instances[lastIndex]);\n"
+	"\t\tpool.instanceSlots[index] = pool.instanceSlots[lastIndex];\n"
+	"\t\tpool.slotInstances[pool.instanceSlots[index]] = index;\n"
+	"\t}\n"
+	"\tpool.instances.pop_back();\n"
+	"\tpool.instanceSlots.pop_back();\n"
+	"\tpool.slotGenerations[slot]++;\n"
+	"\tpool.slotInstances[slot] = pool.firstFreeSlot;\n"
+	"\tpool.firstFreeSlot = slot;\n"
+	"\treturn true;\n"
+	"}\n"
+	"#endif// KCPP_POOL_DEFINED\n";
+/** Emit the statements which make `value` the active variant `d` of a PTU 
+ * instance, each on its own line which begins with `indent`. 
+ * @param ptuAccess the PTU instance followed by its member access operator 
+ *                  (`ptu.` or `ptu->`) */
+static void kcppEmitSetVariant(KEmitter& out, const KPtuDatabase& db, 
+                               uint32_t ptu, uint32_t d, 
+                               string_view ptuAccess, string_view value, 
+                               string_view indent = "\t")
+{
+	const string_view ptuId = ksymbolString(db.ptus[ptu].identifier);
+	const string_view derivedId = 
+		ksymbolString(db.derivedStructs[d].identifier);
+	kemit(out, indent);
+	kemit(out, ptuAccess);
+	/* a packed PTU's tag is a member of each variant's struct, so the entire 
+		struct is assigned at once */
+	if(kcppPtuIsPacked(db, ptu))
+	{
+		kemit(out, "kcppVariant");
+		kemitTitleCase(out, derivedId);
+		kemit(out, " = {");
+		kemit(out, ptuId);
+		kemit(out, "::Type::");
+		kemitUpperCase(out, derivedId);
+		kemit(out, ", ");
+		kemit(out, value);
+		kemit(out, "};\n");
+		return;
+	}
+	kemit(out, "type = ");
+	kemit(out, ptuId);
+	kemit(out, "::Type::");
+	kemitUpperCase(out, derivedId);
+	kemit(out, ";\n");
+	kemit(out, indent);
+	kemit(out, ptuAccess);
+	kemitCamelCase(out, derivedId);
+	kemit(out, " = ");
+	kemit(out, value);
+	kemit(out, ";\n");
+}
+/** Emit the type of the member of a PTU instance which stores the derived 
+ * struct `d`; a boxed derived struct is stored by its pointer. */
+static void kcppEmitVariantType(KEmitter& out, const KPtuDatabase& db, 
+                                uint32_t d)
+{
+	kemitTitleCase(out, ksymbolString(db.derivedStructs[d].identifier));
+	if(db.derivedStructs[d].boxed)
+		kemit(out, "*");
+}
+/* The pools file stores the instances of each derived struct of a PTU in 
+	their own pool, so that every instance of a pool has the same type & a 
+	function can be called on all of them without dispatching on each one.  
+	A pool only stores its derived struct (or the pointer to a boxed derived 
+	struct) without the tag, so each instance costs the size of its own 
+	variant instead of the size of the PTU.  The overrides take a pointer to a 
+	PTU, so `<function>Pools` copies each instance into a PTU on the stack, 
+	calls the overrides, & copies the instance back; overrides called this way 
+	must not keep the pointer to the PTU, or change its type.  The file must 
+	be included after the definition of the PTU & the declarations of the 
+	overrides. */
+static void 
+	generatePolymorphicTaggedUnionPools(KEmitter& out, 
+	                                    const KPtuDatabase& db, uint32_t ptu)
+{
+	const string_view ptuId = ksymbolString(db.ptus[ptu].identifier);
+	const vector<uint32_t> derivedStructs = kptuSortedDerivedStructs(db, ptu);
+	kemit(out, "#pragma once\n");
+	kemit(out, "#include <cstdint>\n");
+	kemit(out, "#include <vector>\n");
+	kemit(out, KCPP_POOL_DEFINITION);
+	/* the container & handles */
+	kemit(out, "struct ");
+	kemit(out, ptuId);
+	kemit(out, "Handle\n{\n\t");
+	kemit(out, ptuId);
+	kemit(out, "::Type type;\n\tuint32_t slot;\n\tuint32_t generation;\n};\n");
+	kemit(out, "struct ");
+	kemit(out, ptuId);
+	kemit(out, "Pools\n{\n");
+	for(const uint32_t d : derivedStructs)
+	{
+		kemit(out, "\tKcppPool<");
+		kcppEmitVariantType(out, db, d);
+		kemit(out, "> ");
+		kemitCamelCase(out, ksymbolString(db.derivedStructs[d].identifier));
+		kemit(out, ";\n");
+	}
+	kemit(out, "};\n");
+	/* typed insertion & lookup */
+	for(const uint32_t d : derivedStructs)
+	{
+		const string_view derivedId = 
+			ksymbolString(db.derivedStructs[d].identifier);
+		const bool boxed = db.derivedStructs[d].boxed;
+		kemit(out, "inline ");
+		kemit(out, ptuId);
+		kemit(out, "Handle ");
+		kemitCamelCase(out, ptuId);
+		kemit(out, "PoolsInsert(");
+		kemit(out, ptuId);
+		/* boxed instances are inserted by their pointer */
+		kemit(out, boxed ? "Pools& pools, " : "Pools& pools, const ");
+		kemitTitleCase(out, derivedId);
+		kemit(out, boxed ? "* instance)\n{\n" : "& instance)\n{\n");
+		kemit(out, "\tconst uint32_t slot = kcppPoolInsert(pools.");
+		kemitCamelCase(out, derivedId);
+		kemit(out, ", instance);\n");
+		kemit(out, "\treturn {");
+		kemit(out, ptuId);
+		kemit(out, "::Type::");
+		kemitUpperCase(out, derivedId);
+		kemit(out, ", slot, pools.");
+		kemitCamelCase(out, derivedId);
+		kemit(out, ".slotGenerations[slot]};\n}\n");
+		/* the lookup is null if the handle is stale or of another type */
+		kemit(out, "inline ");
+		kemitTitleCase(out, derivedId);
+		kemit(out, "* ");
+		kemitCamelCase(out, ptuId);
+		kemit(out, "PoolsGet");
+		kemitTitleCase(out, derivedId);
+		kemit(out, "(");
+		kemit(out, ptuId);
+		kemit(out, "Pools& pools, ");
+		kemit(out, ptuId);
+		kemit(out, "Handle handle)\n{\n");
+		kemit(out, "\tif(handle.type != ");
+		kemit(out, ptuId);
+		kemit(out, "::Type::");
+		kemitUpperCase(out, derivedId);
+		kemit(out, ")\n\t\treturn nullptr;\n");
+		if(boxed)
+		{
+			kemit(out, "\t");
+			kemitTitleCase(out, derivedId);
+			kemit(out, "*const* instance = kcppPoolGet(pools.");
+			kemitCamelCase(out, derivedId);
+			kemit(out, ", handle.slot, \n\t\thandle.generation);\n");
+			kemit(out, "\treturn instance ? *instance : nullptr;\n}\n");
 		}
-	result.append("};\n");
-	return result;
+		else
+		{
+			kemit(out, "\treturn kcppPoolGet(pools.");
+			kemitCamelCase(out, derivedId);
+			kemit(out, ", handle.slot, handle.generation);\n}\n");
+		}
+	}
+	/* erasure by handle */
+	kemit(out, "inline bool ");
+	kemitCamelCase(out, ptuId);
+	kemit(out, "PoolsErase(");
+	kemit(out, ptuId);
+	kemit(out, "Pools& pools, ");
+	kemit(out, ptuId);
+	kemit(out, "Handle handle)\n{\n");
+	kemit(out, "\tswitch(handle.type)\n\t{\n");
+	for(const uint32_t d : derivedStructs)
+	{
+		const string_view derivedId = 
+			ksymbolString(db.derivedStructs[d].identifier);
+		kemit(out, "\tcase ");
+		kemit(out, ptuId);
+		kemit(out, "::Type::");
+		kemitUpperCase(out, derivedId);
+		kemit(out, ":\n\t\treturn kcppPoolErase(pools.");
+		kemitCamelCase(out, derivedId);
+		kemit(out, ", handle.slot, handle.generation);\n");
+	}
+	kemit(out, "\tdefault:\n\t\treturn false;\n\t}\n}\n");
+	/* iterate over each pool & call the overrides of each void pure virtual 
+		function directly */
+	for(const uint32_t v : kptuSortedVirtualFunctions(db, ptu))
+	{
+		const KPtuVirtualFunction& virtualFunction = db.virtualFunctions[v];
+		const KPtuFunctionSignature& signature = virtualFunction.signature;
+		if(!kcppFunctionReturnsVoid(signature))
+			continue;
+		const string_view functionId = 
+			ksymbolString(virtualFunction.identifier);
+		kemit(out, "inline void ");
+		kemit(out, functionId);
+		kemit(out, "Pools(\n\t\t");
+		kemit(out, ptuId);
+		kemit(out, "Pools& pools");
+		for(size_t p = 1; p < signature.params.size(); p++)
+		{
+			kemit(out, ", ");
+			for(const StringToken& st : signature.params[p].qualifierTokens)
+				kemit(out, st.str);
+		}
+		kemit(out, ")\n{\n");
+		kemit(out, "\t");
+		kemit(out, ptuId);
+		kemit(out, " kcppPtu = {};\n");
+		for(const uint32_t d : derivedStructs)
+		{
+			kemit(out, "\tfor(");
+			kcppEmitVariantType(out, db, d);
+			kemit(out, "& kcppInstance : pools.");
+			kemitCamelCase(out, ksymbolString(db.derivedStructs[d].identifier));
+			kemit(out, ".instances)\n\t{\n");
+			kcppEmitSetVariant(out, db, ptu, d, "kcppPtu.", "kcppInstance", 
+			                   "\t\t");
+			/* types which don't override the function go through the 
+				dispatcher, which reports them */
+			const uint32_t firstOverride = kptuFirstOverride(db, d, v);
+			if(firstOverride == KPTU_INVALID_INDEX)
+			{
+				kemit(out, "\t\t");
+				kemit(out, functionId);
+				kemit(out, "(");
+				kcppEmitArguments(out, signature, "&kcppPtu");
+				kemit(out, ");\n");
+			}
+			for(uint32_t o = firstOverride; o != KPTU_INVALID_INDEX; 
+				o = db.functionOverrides[o].nextOverridingSameFunction)
+			{
+				kemit(out, "\t\t");
+				kemit(out, ksymbolString(db.functionOverrides[o].identifier));
+				kemit(out, "(");
+				kcppEmitArguments(out, signature, "&kcppPtu");
+				kemit(out, ");\n");
+			}
+			kemit(out, "\t\tkcppInstance = kcppPtu.");
+			kcppEmitVariantMember(out, db, d);
+			kemit(out, ";\n");
+			kemit(out, "\t}\n");
+		}
+		kemit(out, "}\n");
+	}
+}
+/* The out-of-line storage of boxed derived structs is emitted into every 
+	layout file, so it is guarded against being defined more than once per 
+	translation unit. */
+static const char*const KCPP_BOX_POOL_DEFINITION = 
+	"#ifndef KCPP_BOX_POOL_DEFINED\n"
+	"#define KCPP_BOX_POOL_DEFINED\n"
+	"/* A free-list allocator of boxed instances.  Blocks are never moved or\n"
+	"\tfreed, so a boxed instance's address is a stable handle to it. */\n"
+	"template<class T>\n"
+	"struct KcppBoxPool\n"
+	"{\n"
+	"\tunion Cell\n"
+	"\t{\n"
+	"\t\tCell* nextFree;\n"
+	"\t\talignas(T) unsigned char storage[sizeof(T)];\n"
+	"\t};\n"
+	"\tstatic const size_t BLOCK_SIZE = 64;\n"
+	"\tCell* firstFree = nullptr;\n"
+	"};\n"
+	"template<class T>\n"
+	"inline T* kcppBoxPoolNew(KcppBoxPool<T>& pool, const T& instance)\n"
+	"{\n"
+	"\tusing Cell = typename KcppBoxPool<T>::Cell;\n"
+	"\tif(!pool.firstFree)\n"
+	"\t{\n"
+	"\t\tCell*const block = new Cell[KcppBoxPool<T>::BLOCK_SIZE];\n"
+	"\t\tfor(size_t c = 0; c < KcppBoxPool<T>::BLOCK_SIZE; c++)\n"
+	"\t\t\tblock[c].nextFree = c + 1 < KcppBoxPool<T>::BLOCK_SIZE \n"
+	"\t\t\t\t? &block[c + 1] : nullptr;\n"
+	"\t\tpool.firstFree = block;\n"
+	"\t}\n"
+	"\tCell*const cell = pool.firstFree;\n"
+	"\tpool.firstFree = cell->nextFree;\n"
+	"\treturn new(cell->storage) T(instance);\n"
+	"}\n"
+	"template<class T>\n"
+	"inline void kcppBoxPoolDelete(KcppBoxPool<T>& pool, T* instance)\n"
+	"{\n"
+	"\tusing Cell = typename KcppBoxPool<T>::Cell;\n"
+	"\tif(!instance)\n"
+	"\t\treturn;\n"
+	"\tinstance->~T();\n"
+	"\tCell*const cell = reinterpret_cast<Cell*>(instance);\n"
+	"\tcell->nextFree = pool.firstFree;\n"
+	"\tpool.firstFree = cell;\n"
+	"}\n"
+	"#endif// KCPP_BOX_POOL_DEFINED\n";
+/** Emit a table named `<PTU>_VARIANT_<tableSuffix>` which contains one 
+ * element per derived struct of `ptu`, in the order of the PTU's type enum. */
+static void 
+	kcppEmitLayoutTable(KEmitter& out, const KPtuDatabase& db, uint32_t ptu, 
+	                    const vector<uint32_t>& derivedStructs, 
+	                    string_view elementType, string_view tableSuffix, 
+	                    void (*emitElement)(KEmitter&, const KPtuDerivedStruct&))
+{
+	kemit(out, "static constexpr ");
+	kemit(out, elementType);
+	kemit(out, " ");
+	kemitUpperCase(out, ksymbolString(db.ptus[ptu].identifier));
+	kemit(out, "_VARIANT_");
+	kemit(out, tableSuffix);
+	kemit(out, "[] = \n");
+	for(size_t d = 0; d < derivedStructs.size(); d++)
+	{
+		kemit(out, d == 0 ? "\t{ " : "\t, ");
+		emitElement(out, db.derivedStructs[derivedStructs[d]]);
+		kemit(out, "\n");
+	}
+	kemit(out, "\t};\n");
+}
+/* The layout file describes how much space each derived struct takes up 
+	inside the PTU's union, so that large variants can be found & boxed.  kcpp 
+	never sees the definitions of the derived structs, so the sizes are 
+	computed by the compiler; an optional `<PTU>_MAX_VARIANT_SIZE` budget is 
+	enforced with static_asserts, & `--layout-report` additionally generates a 
+	function which prints the bytes wasted per variant.  Boxed derived structs 
+	are given a pool along with functions to box & unbox them.  The space saved 
+	by the PTU's tag is verified against the default u16 tag which precedes 
+	the union, & a packed PTU is given functions to access its tag & its 
+	variants.  The file must be included after the definitions of the PTU & 
+	its derived structs. */
+static void 
+	generatePolymorphicTaggedUnionLayout(KEmitter& out, 
+	                                     const KPtuDatabase& db, uint32_t ptu)
+{
+	const string_view ptuId = ksymbolString(db.ptus[ptu].identifier);
+	const vector<uint32_t> derivedStructs = kptuSortedDerivedStructs(db, ptu);
+	kemit(out, "#pragma once\n");
+	if(derivedStructs.empty())
+		return;
+	bool anyBoxed = false;
+	for(const uint32_t d : derivedStructs)
+		anyBoxed = anyBoxed || db.derivedStructs[d].boxed;
+	const bool packedTag = kcppPtuIsPacked(db, ptu);
+	kemit(out, "#include <cstddef>\n");
+	if(packedTag)
+		kemit(out, "#include <type_traits>\n");
+	if(anyBoxed)
+	{
+		kemit(out, "#include <new>\n");
+		kemit(out, KCPP_BOX_POOL_DEFINITION);
+	}
+	if(g_layoutReport)
+		kemit(out, "#include <cstdio>\n");
+	/* the inline size & alignment of each variant */
+	kcppEmitLayoutTable(out, db, ptu, derivedStructs, "const char*", "NAMES", 
+		[](KEmitter& out, const KPtuDerivedStruct& derivedStruct)
+		{
+			kemit(out, "\"");
+			kemitTitleCase(out, ksymbolString(derivedStruct.identifier));
+			kemit(out, "\"");
+		});
+	kcppEmitLayoutTable(out, db, ptu, derivedStructs, "size_t", "SIZES", 
+		[](KEmitter& out, const KPtuDerivedStruct& derivedStruct)
+		{
+			kemit(out, "sizeof(");
+			kcppEmitUnionMemberType(out, derivedStruct);
+			kemit(out, ")");
+		});
+	kcppEmitLayoutTable(out, db, ptu, derivedStructs, "size_t", "ALIGNMENTS", 
+		[](KEmitter& out, const KPtuDerivedStruct& derivedStruct)
+		{
+			kemit(out, "alignof(");
+			kcppEmitUnionMemberType(out, derivedStruct);
+			kemit(out, ")");
+		});
+	kcppEmitLayoutTable(out, db, ptu, derivedStructs, "bool", "BOXED", 
+		[](KEmitter& out, const KPtuDerivedStruct& derivedStruct)
+		{
+			kemit(out, derivedStruct.boxed ? "true" : "false");
+		});
+	kemit(out, "static_assert(sizeof(");
+	kemitUpperCase(out, ptuId);
+	kemit(out, "_VARIANT_SIZES) / sizeof(size_t) == \n\tstatic_cast<size_t>(");
+	kemit(out, ptuId);
+	kemit(out, "::Type::ENUM_COUNT), \"layout tables are out of date!\");\n");
+	/* the optional budget of inline variants */
+	kemit(out, "#ifdef ");
+	kemitUpperCase(out, ptuId);
+	kemit(out, "_MAX_VARIANT_SIZE\n");
+	for(const uint32_t d : derivedStructs)
+	{
+		if(db.derivedStructs[d].boxed)
+			continue;
+		const string_view derivedId = 
+			ksymbolString(db.derivedStructs[d].identifier);
+		kemit(out, "static_assert(sizeof(");
+		kemitTitleCase(out, derivedId);
+		kemit(out, ") <= ");
+		kemitUpperCase(out, ptuId);
+		kemit(out, "_MAX_VARIANT_SIZE, \n\t\"");
+		kemitTitleCase(out, derivedId);
+		kemit(out, " exceeds ");
+		kemitUpperCase(out, ptuId);
+		kemit(out, "_MAX_VARIANT_SIZE; declare it with "
+		           "KCPP_POLYMORPHIC_TAGGED_UNION_EXTENDS_BOXED!\");\n");
+	}
+	kemit(out, "#endif\n");
+	/* the generated tag, compared to a u16 tag which precedes the union */
+	kemit(out, "struct ");
+	kemit(out, ptuId);
+	kemit(out, "TagLayout\n{\n#include \"");
+	kemit(out, generatedFileNameUnion(string(ptuId)));
+	kemit(out, "\"\n};\n");
+	kemit(out, "struct ");
+	kemit(out, ptuId);
+	kemit(out, "U16TagLayout\n{\n\tu16 type;\n\tunion\n\t{\n");
+	kcppEmitUnionMembers(out, db, derivedStructs, "\t\t");
+	kemit(out, "\t};\n};\n");
+	kemit(out, "static_assert(sizeof(");
+	kemit(out, ptuId);
+	kemit(out, "TagLayout) <= sizeof(");
+	kemit(out, ptuId);
+	kemit(out, "U16TagLayout), \n\t\"");
+	kemit(out, ptuId);
+	kemit(out, "'s tag is larger than a u16 tag!\");\n");
+	if(packedTag)
+	{
+		/* the packed tag must take up no more space than an unpacked tag of 
+			the same width */
+		kemit(out, "struct ");
+		kemit(out, ptuId);
+		kemit(out, "UnpackedTagLayout\n{\n\t");
+		kemit(out, ptuId);
+		kemit(out, "::Type type;\n\tunion\n\t{\n");
+		kcppEmitUnionMembers(out, db, derivedStructs, "\t\t");
+		kemit(out, "\t};\n};\n");
+		kemit(out, "static_assert(sizeof(");
+		kemit(out, ptuId);
+		kemit(out, "TagLayout) <= sizeof(");
+		kemit(out, ptuId);
+		kemit(out, "UnpackedTagLayout), \n\t\"");
+		kemit(out, ptuId);
+		kemit(out, "'s packed tag is larger than its unpacked tag!\");\n");
+		/* the tag may only be read through an inactive variant if every 
+			variant is standard-layout */
+		for(const uint32_t d : derivedStructs)
+		{
+			kemit(out, "static_assert(std::is_standard_layout<");
+			kemit(out, ptuId);
+			kemit(out, "::KcppVariant");
+			kemitTitleCase(out, ksymbolString(db.derivedStructs[d].identifier));
+			kemit(out, ">::value, \n\t\"");
+			kemitTitleCase(out, ksymbolString(db.derivedStructs[d].identifier));
+			kemit(out, " must be standard-layout to be stored in a packed PTU!"
+			           "\");\n");
+		}
+		kemit(out, "inline ");
+		kemit(out, ptuId);
+		kemit(out, "::Type ");
+		kemitCamelCase(out, ptuId);
+		kemit(out, "GetType(const ");
+		kemit(out, ptuId);
+		kemit(out, "* ptu)\n{\n\treturn ptu->");
+		kcppEmitTagMember(out, db, ptu);
+		kemit(out, ";\n}\n");
+		/* a pointer to each variant's instance, whether it is boxed or not, 
+			& a setter of each variant which isn't boxed; boxed variants are 
+			set by boxing them */
+		for(const uint32_t d : derivedStructs)
+		{
+			const string_view derivedId = 
+				ksymbolString(db.derivedStructs[d].identifier);
+			const bool boxed = db.derivedStructs[d].boxed;
+			for(const string_view constQualifier : {"", "const "})
+			{
+				kemit(out, "inline ");
+				kemit(out, constQualifier);
+				kemitTitleCase(out, derivedId);
+				kemit(out, "* ");
+				kemitCamelCase(out, ptuId);
+				kemit(out, "Get");
+				kemitTitleCase(out, derivedId);
+				kemit(out, "(");
+				kemit(out, constQualifier);
+				kemit(out, ptuId);
+				kemit(out, boxed ? "* ptu)\n{\n\treturn ptu->" 
+				                 : "* ptu)\n{\n\treturn &ptu->");
+				kcppEmitVariantMember(out, db, d);
+				kemit(out, ";\n}\n");
+			}
+			if(boxed)
+				continue;
+			kemit(out, "inline void ");
+			kemitCamelCase(out, ptuId);
+			kemit(out, "Set");
+			kemitTitleCase(out, derivedId);
+			kemit(out, "(");
+			kemit(out, ptuId);
+			kemit(out, "* ptu, const ");
+			kemitTitleCase(out, derivedId);
+			kemit(out, "& instance)\n{\n");
+			kcppEmitSetVariant(out, db, ptu, d, "ptu->", "instance");
+			kemit(out, "}\n");
+		}
+	}
+	if(g_layoutReport)
+	{
+		kemit(out, "inline void ");
+		kemitCamelCase(out, ptuId);
+		kemit(out, "PrintLayoutReport()\n{\n");
+		kemit(out, "\tconst size_t count = static_cast<size_t>(");
+		kemit(out, ptuId);
+		kemit(out, "::Type::ENUM_COUNT);\n");
+		kemit(out, "\tsize_t unionSize = 0;\n");
+		kemit(out, "\tfor(size_t t = 0; t < count; t++)\n");
+		kemit(out, "\t\tif(");
+		kemitUpperCase(out, ptuId);
+		kemit(out, "_VARIANT_SIZES[t] > unionSize)\n\t\t\tunionSize = ");
+		kemitUpperCase(out, ptuId);
+		kemit(out, "_VARIANT_SIZES[t];\n");
+		kemit(out, "\tprintf(\"");
+		kemit(out, ptuId);
+		kemit(out, ": %zu bytes, union: %zu bytes\\n\", sizeof(");
+		kemit(out, ptuId);
+		kemit(out, "), unionSize);\n");
+		kemit(out, "\tfor(size_t t = 0; t < count; t++)\n");
+		kemit(out, "\t\tprintf(\"\\t%-32s %6zu bytes inline, %6zu wasted%s\\n\", "
+		           "\n\t\t       ");
+		kemitUpperCase(out, ptuId);
+		kemit(out, "_VARIANT_NAMES[t], ");
+		kemitUpperCase(out, ptuId);
+		kemit(out, "_VARIANT_SIZES[t], \n\t\t       unionSize - ");
+		kemitUpperCase(out, ptuId);
+		kemit(out, "_VARIANT_SIZES[t], ");
+		kemitUpperCase(out, ptuId);
+		kemit(out, "_VARIANT_BOXED[t] ? \" (boxed)\" : \"\");\n}\n");
+	}
+	/* out-of-line storage of boxed variants */
+	for(const uint32_t d : derivedStructs)
+	{
+		if(!db.derivedStructs[d].boxed)
+			continue;
+		const string_view derivedId = 
+			ksymbolString(db.derivedStructs[d].identifier);
+		kemit(out, "inline KcppBoxPool<");
+		kemitTitleCase(out, derivedId);
+		kemit(out, ">& ");
+		kemitCamelCase(out, ptuId);
+		kemitTitleCase(out, derivedId);
+		kemit(out, "BoxPool()\n{\n\tstatic KcppBoxPool<");
+		kemitTitleCase(out, derivedId);
+		kemit(out, "> pool;\n\treturn pool;\n}\n");
+		kemit(out, "inline void ");
+		kemitCamelCase(out, ptuId);
+		kemit(out, "Box");
+		kemitTitleCase(out, derivedId);
+		kemit(out, "(");
+		kemit(out, ptuId);
+		kemit(out, "* ptu, const ");
+		kemitTitleCase(out, derivedId);
+		kemit(out, "& instance)\n{\n\t");
+		kemitTitleCase(out, derivedId);
+		kemit(out, "*const kcppBoxed = kcppBoxPoolNew(");
+		kemitCamelCase(out, ptuId);
+		kemitTitleCase(out, derivedId);
+		kemit(out, "BoxPool(), instance);\n");
+		kcppEmitSetVariant(out, db, ptu, d, "ptu->", "kcppBoxed");
+		kemit(out, "}\n");
+		kemit(out, "inline void ");
+		kemitCamelCase(out, ptuId);
+		kemit(out, "Unbox");
+		kemitTitleCase(out, derivedId);
+		kemit(out, "(");
+		kemit(out, ptuId);
+		kemit(out, "* ptu)\n{\n\tkcppBoxPoolDelete(");
+		kemitCamelCase(out, ptuId);
+		kemitTitleCase(out, derivedId);
+		kemit(out, "BoxPool(), ptu->");
+		kcppEmitVariantMember(out, db, d);
+		kemit(out, ");\n\tptu->");
+		kcppEmitVariantMember(out, db, d);
+		kemit(out, " = nullptr;\n}\n");
+	}
+}
+/* The multi-PTU `visit` overloads are emitted into every visit file, so they 
+	are guarded against being defined more than once per translation unit.  
+	They only accept PTUs which have a KcppPtu specialization, & find the 
+	single-PTU overloads by argument-dependent lookup. */
+static const char*const KCPP_VISIT_DEFINITION = 
+	"#ifndef KCPP_VISIT_DEFINED\n"
+	"#define KCPP_VISIT_DEFINED\n"
+	"/* specialized for every PTU which has a visit file */\n"
+	"template<class Ptu>\n"
+	"struct KcppPtu;\n"
+	"template<class Ptu0, class Ptu1, class F, \n"
+	"\tsize_t = KcppPtu<typename std::remove_const<Ptu0>::type>::TYPE_COUNT, \n"
+	"\tsize_t = KcppPtu<typename std::remove_const<Ptu1>::type>::TYPE_COUNT>\n"
+	"inline decltype(auto) visit(Ptu0& ptu0, Ptu1& ptu1, F&& f)\n"
+	"{\n"
+	"\treturn visit(ptu0, [&](auto& derived0) -> decltype(auto)\n"
+	"\t\t{\n"
+	"\t\t\treturn visit(ptu1, [&](auto& derived1) -> decltype(auto)\n"
+	"\t\t\t\t{\n"
+	"\t\t\t\t\treturn std::forward<F>(f)(derived0, derived1);\n"
+	"\t\t\t\t});\n"
+	"\t\t});\n"
+	"}\n"
+	"template<class Ptu0, class Ptu1, class Ptu2, class F, \n"
+	"\tsize_t = KcppPtu<typename std::remove_const<Ptu0>::type>::TYPE_COUNT, \n"
+	"\tsize_t = KcppPtu<typename std::remove_const<Ptu1>::type>::TYPE_COUNT, \n"
+	"\tsize_t = KcppPtu<typename std::remove_const<Ptu2>::type>::TYPE_COUNT>\n"
+	"inline decltype(auto) visit(Ptu0& ptu0, Ptu1& ptu1, Ptu2& ptu2, F&& f)\n"
+	"{\n"
+	"\treturn visit(ptu0, [&](auto& derived0) -> decltype(auto)\n"
+	"\t\t{\n"
+	"\t\t\treturn visit(ptu1, ptu2, [&](auto& derived1, auto& derived2) \n"
+	"\t\t\t\t-> decltype(auto)\n"
+	"\t\t\t\t{\n"
+	"\t\t\t\t\treturn std::forward<F>(f)(derived0, derived1, derived2);\n"
+	"\t\t\t\t});\n"
+	"\t\t});\n"
+	"}\n"
+	"#endif// KCPP_VISIT_DEFINED\n";
+/* The visit file is a header-only alternative to declaring a pure virtual 
+	function for one-off operations; `visit(ptu, f)` calls `f` with a 
+	reference to the active derived struct, like std::visit.  Each case is a 
+	direct call of `f`, so the compiler can inline it, & `<Ptu>Variant` maps 
+	each Type to its derived struct at compile time.  All the calls of `f` 
+	must return the same type.  The file requires C++14, & must be included 
+	after the definitions of the PTU & its derived structs. */
+static void 
+	generatePolymorphicTaggedUnionVisit(KEmitter& out, 
+	                                    const KPtuDatabase& db, uint32_t ptu)
+{
+	const string_view ptuId = ksymbolString(db.ptus[ptu].identifier);
+	const vector<uint32_t> derivedStructs = kptuSortedDerivedStructs(db, ptu);
+	kemit(out, "#pragma once\n");
+	if(derivedStructs.empty())
+		return;
+	kemit(out, "#include <cstddef>\n");
+	kemit(out, "#include <cstdlib>\n");
+	kemit(out, "#include <type_traits>\n");
+	kemit(out, "#include <utility>\n");
+	kemit(out, KCPP_VISIT_DEFINITION);
+	char typeCount[32];
+	snprintf(typeCount, sizeof(typeCount), "%zu", derivedStructs.size());
+	kemit(out, "template<>\nstruct KcppPtu<");
+	kemit(out, ptuId);
+	kemit(out, ">\n{\n\tstatic const size_t TYPE_COUNT = ");
+	kemit(out, typeCount);
+	kemit(out, ";\n};\n");
+	/* the compile-time mapping of Type -> derived struct */
+	kemit(out, "template<");
+	kemit(out, ptuId);
+	kemit(out, "::Type TYPE>\nstruct ");
+	kemit(out, ptuId);
+	kemit(out, "Variant;\n");
+	for(const uint32_t d : derivedStructs)
+	{
+		const KPtuDerivedStruct& derivedStruct = db.derivedStructs[d];
+		const string_view derivedId = ksymbolString(derivedStruct.identifier);
+		kemit(out, "template<>\nstruct ");
+		kemit(out, ptuId);
+		kemit(out, "Variant<");
+		kemit(out, ptuId);
+		kemit(out, "::Type::");
+		kemitUpperCase(out, derivedId);
+		kemit(out, ">\n{\n\tusing Derived = ");
+		kemitTitleCase(out, derivedId);
+		kemit(out, ";\n");
+		for(const string_view constQualifier : {"", "const "})
+		{
+			kemit(out, "\tstatic ");
+			kemit(out, constQualifier);
+			kemitTitleCase(out, derivedId);
+			kemit(out, "& get(");
+			kemit(out, constQualifier);
+			kemit(out, ptuId);
+			/* boxed derived structs are stored out of line */
+			kemit(out, derivedStruct.boxed ? "& ptu)\n\t{\n\t\treturn *ptu." 
+			                               : "& ptu)\n\t{\n\t\treturn ptu.");
+			kcppEmitVariantMember(out, db, d);
+			kemit(out, ";\n\t}\n");
+		}
+		kemit(out, "};\n");
+	}
+	for(const string_view constQualifier : {"", "const "})
+	{
+		kemit(out, "template<class F>\ninline decltype(auto) visit(");
+		kemit(out, constQualifier);
+		kemit(out, ptuId);
+		kemit(out, "& ptu, F&& f)\n{\n");
+		kemit(out, "\tswitch(ptu.");
+		kcppEmitTagMember(out, db, ptu);
+		kemit(out, ")\n\t{\n");
+		for(const uint32_t d : derivedStructs)
+		{
+			const string_view derivedId = 
+				ksymbolString(db.derivedStructs[d].identifier);
+			kemit(out, "\tcase ");
+			kemit(out, ptuId);
+			kemit(out, "::Type::");
+			kemitUpperCase(out, derivedId);
+			kemit(out, ":\n\t\treturn std::forward<F>(f)(");
+			kemit(out, ptuId);
+			kemit(out, "Variant<");
+			kemit(out, ptuId);
+			kemit(out, "::Type::");
+			kemitUpperCase(out, derivedId);
+			kemit(out, ">::get(ptu));\n");
+		}
+		kemit(out, "\tcase ");
+		kemit(out, ptuId);
+		kemit(out, "::Type::ENUM_COUNT:\n");
+		kemit(out, "\tdefault:\n");
+		kemit(out, "\tbreak;\n");
+		kemit(out, "\t}\n");
+		/* there is no derived struct to call `f` with */
+		kemit(out, "\tKLOG(ERROR, \"Invalid type (%i)!\", ptu.");
+		kcppEmitTagMember(out, db, ptu);
+		kemit(out, ");\n");
+		kemit(out, "\tabort();\n");
+		kemit(out, "}\n");
+	}
+}
+/** Recursively gather all the files in `fsPathInput`, so that they can be 
+ * parsed in parallel. */
+static void gatherInputFiles(const fs::path& fsPathInput, 
+                             vector<ParsedFile>& outParsedFiles)
+{
+	/* @TODO: ignore files that aren't C++ */
+	for(const fs::directory_entry& fsDirEnt : 
+		fs::recursive_directory_iterator(fsPathInput))
+	{
+		if(fsDirEnt.is_directory())
+			continue;
+		if(!fsDirEnt.is_regular_file())
+			continue;
+		if(g_verbose)
+			printf("kcpp('%ws')\n", fsDirEnt.path().c_str());
+		outParsedFiles.push_back(
+			{ .path          = fsDirEnt.path()
+			, .fileSize      = fsDirEnt.file_size()
+			, .lastWriteTime = kcacheLastWriteTime(fsDirEnt) });
+	}
+}
+/** Rebuild the PTU database & the KASSET registry from scratch.  The files are 
+ * merged in directory order, so that the PTU database (and therefore the 
+ * generated code) does not depend on thread scheduling.  
+ * @return false if any of the files could not be read */
+static bool mergeParsedFiles(const vector<ParsedFile>& parsedFiles)
+{
+	bool success = true;
+	kptuDatabaseFree(g_ptuDatabase);
+	kassetRegistryFree(g_kassetRegistry);
+	string decodedPath;
+	for(const ParsedFile& parsedFile : parsedFiles)
+	{
+		if(parsedFile.readFailure)
+		{
+			fprintf(stderr, "Failed to read file '%ws'!\n", 
+			        parsedFile.path.c_str());
+			success = false;
+			continue;
+		}
+		mergeParsedFile(parsedFile);
+		for(const string_view kasset : parsedFile.kassets)
+		{
+			/* the literal was already validated by the parser */
+			kassetDecodeLiteral(kasset, decodedPath);
+			kassetRegistryInsert(g_kassetRegistry, decodedPath);
+		}
+	}
+	kassetRegistryAddImpliedAssets(g_kassetRegistry);
+	kassetRegistrySort(g_kassetRegistry);
+	kptuBuildOverrideIndex(g_ptuDatabase);
+	return success;
 }
+/** Generate all the code files of a single PTU into `fsPathOutput`.  
+ * @return false if any of the files could not be written */
+static bool writePolymorphicTaggedUnionFiles(const fs::path& fsPathOutput, 
+                                             const KPtuDatabase& db, 
+                                             uint32_t ptu)
+{
+	bool success = true;
+	const string ptuId = string(ksymbolString(db.ptus[ptu].identifier));
+	/* all the files are generated into the same reusable buffer */
+	const struct
+	{
+		string fileName;
+		void (*generate)(KEmitter&, const KPtuDatabase&, uint32_t);
+	} generatedFiles[] = 
+		/* the code file which defines all pure virtual function dispatchers 
+			declared for this PTU struct */
+		{ { generatedFileNameDispatch(ptuId), 
+		    generatePolymorphicTaggedUnionDispatch }
+		/* the code file which declares the functions of the dispatch file 
+			which aren't declared by the user */
+		, { generatedFileNameDispatchHeader(ptuId), 
+		    generatePolymorphicTaggedUnionDispatchHeader }
+		/* the code file which includes all the source files which define the 
+			structures which make up the union within the PTU */
+		, { generatedFileNameIncludes(ptuId), 
+		    generatePolymorphicTaggedUnionIncludes }
+		/* the code file which declares the anonomous union of the PTU */
+		, { generatedFileNameUnion(ptuId), 
+		    generatePolymorphicTaggedUnion }
+		/* the code file which declares optional per-derived-struct storage 
+			pools for the PTU */
+		, { generatedFileNamePools(ptuId), 
+		    generatePolymorphicTaggedUnionPools }
+		/* the code file which describes the size of each variant of the PTU, 
+			& stores its boxed derived structs */
+		, { generatedFileNameLayout(ptuId), 
+		    generatePolymorphicTaggedUnionLayout }
+		/* the header-only code file which visits the active derived struct 
+			of the PTU with a callable */
+		, { generatedFileNameVisit(ptuId), 
+		    generatePolymorphicTaggedUnionVisit } };
+	for(const auto& generatedFile : generatedFiles)
+	{
+		const fs::path outPath = fsPathOutput / generatedFile.fileName;
+		kemitReset(g_emitter);
+		generatedFile.generate(g_emitter, db, ptu);
+		if(!writeEntireFileIfChanged(outPath, g_emitter.data, g_emitter.size))
+		{
+			fprintf(stderr, "Failed to write file '%ws'!\n", 
+					outPath.c_str());
+			success = false;
+		}
+	}
+	return success;
+}
+/** Remove generated files of PTUs which no longer exist in the PTU database 
+ * (as well as any temporary files left behind by an interrupted run).  
+ * @return false if any stale file could not be removed */
+static bool removeStaleGeneratedFiles(const fs::path& fsPathOutput)
+{
+	set<fs::path> generatedFileNames;
+	for(uint32_t p = 0; p < g_ptuDatabase.ptus.count; p++)
+	{
+		const string ptuId = 
+			string(ksymbolString(g_ptuDatabase.ptus[p].identifier));
+		generatedFileNames.insert(generatedFileNameDispatch(ptuId));
+		generatedFileNames.insert(generatedFileNameDispatchHeader(ptuId));
+		generatedFileNames.insert(generatedFileNameIncludes(ptuId));
+		generatedFileNames.insert(generatedFileNameUnion(ptuId));
+		generatedFileNames.insert(generatedFileNamePools(ptuId));
+		generatedFileNames.insert(generatedFileNameLayout(ptuId));
+		generatedFileNames.insert(generatedFileNameVisit(ptuId));
+	}
+	const fs::path::string_type prefix = fs::path(GENERATED_FILE_PREFIX).native();
+	bool success = true;
+	for(const fs::directory_entry& fsDirEnt : 
+		fs::directory_iterator(fsPathOutput))
+	{
+		const fs::path fsPathFileName = fsDirEnt.path().filename();
+		if(!fsDirEnt.is_regular_file() || 
+			fsPathFileName.native().rfind(prefix, 0) != 0 || 
+			generatedFileNames.count(fsPathFileName))
+			continue;
+		if(g_verbose)
+			printf("removing stale '%ws'\n", fsDirEnt.path().c_str());
+		std::error_code errorCode;
+		fs::remove(fsDirEnt.path(), errorCode);
+		if(errorCode)
+		{
+			fprintf(stderr, "Failed to remove stale file '%ws'!\n", 
+			        fsDirEnt.path().c_str());
+			success = false;
+		}
+	}
+	return success;
+}
+/** @return false if the file exists & could not be removed */
+static bool removeStaleFile(const fs::path& fsPath)
+{
+	std::error_code errorCode;
+	if(fs::remove(fsPath, errorCode) && g_verbose)
+		printf("removing stale '%ws'\n", fsPath.c_str());
+	if(errorCode)
+	{
+		fprintf(stderr, "Failed to remove stale file '%ws'!\n", 
+		        fsPath.c_str());
+		return false;
+	}
+	return true;
+}
+/** Generate the KASSET registry header (& the KASSET pack, if enabled) into 
+ * `fsPathOutput`, or remove them if the input files no longer register any 
+ * KASSETs.  
+ * @return false if any file could not be written or removed */
+static bool writeKAssetFiles(const fs::path& fsPathOutput)
+{
+	const fs::path outPath = fsPathOutput / KASSET_GENERATED_FILE_NAME;
+	const bool packEnabled = 
+		!g_kassetPackDirectory.empty() && !g_kassetRegistry.paths.empty();
+	bool success = true;
+	if(!packEnabled)
+	{
+		success = removeStaleFile(fsPathOutput / KPACK_FILE_NAME) && success;
+		success = 
+			removeStaleFile(fsPathOutput / KPACK_MANIFEST_FILE_NAME) && success;
+	}
+	if(g_kassetRegistry.paths.empty())
+		return removeStaleFile(outPath) && success;
+	KPackLayout packLayout = {};
+	if(packEnabled && 
+		!kpackBuildLayout(g_kassetRegistry, g_kassetPackDirectory, packLayout))
+		success = false;
+	kemitReset(g_emitter);
+	generateHeaderKAssets(g_emitter, g_kassetRegistry, 
+	                      packEnabled ? &packLayout : nullptr);
+	if(!writeEntireFileIfChanged(outPath, g_emitter.data, g_emitter.size))
+	{
+		fprintf(stderr, "Failed to write file '%ws'!\n", outPath.c_str());
+		success = false;
+	}
+	if(packEnabled && !kpackWrite(fsPathOutput, g_kassetPackDirectory, 
+	                              g_kassetRegistry, packLayout))
+		success = false;
+	return success;
+}
+#include "watch.cpp"
+#include "benchmark.cpp"
 int 
 	main(int argc, char** argv)
 {
 	const auto timeMainStart = chrono::high_resolution_clock::now();
+	if(argc >= 2 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		return benchmarkMain(
+			argc >= 3 ? vecStringToVecFsPath(split(argv[2], ";")) 
+			          : vector<fs::path>());
+	}
 	if(argc < 2)
 	{
 		fprintf(stderr, "ERROR: incorrect usage!\n");
@@ -1169,6 +3587,9 @@ int
 		return EXIT_FAILURE;
 	}
 	g_verbose = false;
+	g_parseCacheEnabled = true;
+	bool watch = false;
+	unsigned jobCount = std::max(1u, std::thread::hardware_concurrency());
 	const vector<fs::path> vecFsPathInputs = 
 		vecStringToVecFsPath(split(argv[1], ";"));
 	const fs::path fsPathOutput = argv[2];
@@ -1178,6 +3599,36 @@ int
 		{
 			g_verbose = true;
 		}
+		else if(strcmp(argv[a], "--jobs") == 0 && a + 1 < argc && 
+			atoi(argv[a + 1]) > 0)
+		{
+			jobCount = static_cast<unsigned>(atoi(argv[++a]));
+		}
+		else if(strcmp(argv[a], "--no-cache") == 0)
+		{
+			g_parseCacheEnabled = false;
+		}
+		else if(strcmp(argv[a], "--watch") == 0)
+		{
+			watch = true;
+		}
+		else if(strcmp(argv[a], "--layout-report") == 0)
+		{
+			g_layoutReport = true;
+		}
+		else if(strcmp(argv[a], "--instrument") == 0)
+		{
+			g_instrument = true;
+		}
+		else if(strcmp(argv[a], "--kasset-pack") == 0 && a + 1 < argc)
+		{
+			g_kassetPackDirectory = argv[++a];
+		}
+		else if(strcmp(argv[a], "--profile") == 0 && a + 1 < argc)
+		{
+			if(!kprofileLoad(argv[++a]))
+				return EXIT_FAILURE;
+		}
 		else
 		{
 			fprintf(stderr, "ERROR: incorrect usage on param[%i]=='%s'\n",
@@ -1195,87 +3646,75 @@ int
 		}
 		printf("output='%ws'\n", fsPathOutput.c_str());
 	}
-	/* parse all the files recursively in all the provided input directories */
-	/* @TODO: ignore files that aren't C++ */
+	/* the watcher must be subscribed before the input directories are walked, 
+		so that no changes are missed while the initial run is in progress */
+	KWatcher watcher = {};
+	if(watch && !kwatchOpen(watcher, vecFsPathInputs))
+	{
+		fprintf(stderr, "ERROR: failed to watch the input directories!\n");
+		return EXIT_FAILURE;
+	}
+	/* gather all the files recursively in all the provided input directories, 
+		so that they can be parsed in parallel */
 	int result = EXIT_SUCCESS;
+	vector<ParsedFile> parsedFiles;
 	for(const fs::path& fsPathInput : vecFsPathInputs)
+		gatherInputFiles(fsPathInput, parsedFiles);
+	/* files whose size & modification time match the parse cache are served 
+		from the cache without being opened */
+	const fs::path fsPathParseCache = fsPathOutput / KCACHE_FILE_NAME;
+	ParseCache parseCache = {};
+	if(g_parseCacheEnabled)
+		kcacheLoad(fsPathParseCache, parseCache);
+	bool parseCacheDirty = parseCache.entries.size() != parsedFiles.size();
+	for(ParsedFile& parsedFile : parsedFiles)
 	{
-		for(const fs::directory_entry& fsDirEnt : 
-			fs::recursive_directory_iterator(fsPathInput))
+		auto cacheIt = parseCache.entries.find(parsedFile.path.native());
+		if(cacheIt == parseCache.entries.end())
 		{
-			if(fsDirEnt.is_directory())
-				continue;
-			if(!fsDirEnt.is_regular_file())
-				continue;
-			if(g_verbose)
-				printf("kcpp('%ws')\n", fsDirEnt.path().c_str());
-			char*const fileData = 
-				readEntireFile(
-					fsDirEnt.path().c_str(), fs::file_size(fsDirEnt.path()));
-			if(fileData)
-			{
-				processFileData(fileData);
-				free(fileData);
-			}
-			else
-			{
-				fprintf(stderr, "Failed to read file '%ws'!\n", 
-				        fsDirEnt.path().c_str());
-				result = EXIT_FAILURE;
-			}
-		}
-	}
-	/* output generated code into the provided output directory */
-	fs::create_directories(fsPathOutput);
-	for(const auto& ptu : g_polyTaggedUnions)
-	{
-		/* generate the code file which defines all pure virtual function 
-			dispatchers declared for this PTU struct */
-		{
-			const string ptuGenFileNameDispatch = 
-				"gen_ptu_" + ptu.first + "_dispatch.cpp";
-			const fs::path outPathDispatch = 
-				fsPathOutput / ptuGenFileNameDispatch;
-			const string fileData = 
-				generatePolymorphicTaggedUnionDispatch(ptu.first, ptu.second);
-			if(!writeEntireFile(outPathDispatch.c_str(), fileData.c_str()))
-			{
-				fprintf(stderr, "Failed to write file '%ws'!\n", 
-						outPathDispatch.c_str());
-				result = EXIT_FAILURE;
-			}
+			parseCacheDirty = true;
+			continue;
 		}
-		/* generate the code file which includes all the source files which 
-			define the structures which make up the union within the PTU */
-		{
-			const string ptuGenFileNameIncludes = 
-				"gen_ptu_" + ptu.first + "_includes.h";
-			const fs::path outPathIncludes = 
-				fsPathOutput / ptuGenFileNameIncludes;
-			const string fileData = 
-				generatePolymorphicTaggedUnionIncludes(ptu.first, ptu.second);
-			if(!writeEntireFile(outPathIncludes.c_str(), fileData.c_str()))
-			{
-				fprintf(stderr, "Failed to write file '%ws'!\n", 
-						outPathIncludes.c_str());
-				result = EXIT_FAILURE;
-			}
+		ParseCacheEntry& cacheEntry = cacheIt->second;
+		if(cacheEntry.fileSize == parsedFile.fileSize && 
+			cacheEntry.lastWriteTime == parsedFile.lastWriteTime)
+		{
+			parsedFile.isCached    = true;
+			parsedFile.contentHash = cacheEntry.contentHash;
+			parsedFile.ptuEvents   = std::move(cacheEntry.ptuEvents);
+			parsedFile.kassets     = std::move(cacheEntry.kassets);
 		}
-		/* generate the code file which declares the anonomous union of the 
-			PTU */
-		{
-			const string ptuGenFileName = "gen_ptu_" + ptu.first + ".h";
-			const fs::path outPath = fsPathOutput / ptuGenFileName;
-			const string fileData = 
-				generatePolymorphicTaggedUnion(ptu.first, ptu.second);
-			if(!writeEntireFile(outPath.c_str(), fileData.c_str()))
-			{
-				fprintf(stderr, "Failed to write file '%ws'!\n", 
-						outPath.c_str());
-				result = EXIT_FAILURE;
-			}
+		else
+		{
+			parsedFile.cacheEntry = &cacheEntry;
+			parseCacheDirty = true;
 		}
 	}
+	parseInputFiles(parsedFiles, jobCount);
+	if(g_verbose && g_parseCacheEnabled)
+	{
+		size_t cachedFileCount = 0;
+		for(const ParsedFile& parsedFile : parsedFiles)
+			if(parsedFile.isCached)
+				cachedFileCount++;
+		printf("parse cache: %zu/%zu files unchanged\n", 
+		       cachedFileCount, parsedFiles.size());
+	}
+	for(ParsedFile& parsedFile : parsedFiles)
+		parsedFile.cacheEntry = nullptr;
+	if(!mergeParsedFiles(parsedFiles))
+		result = EXIT_FAILURE;
+	/* output generated code into the provided output directory */
+	fs::create_directories(fsPathOutput);
+	if(g_parseCacheEnabled && parseCacheDirty)
+		kcacheSave(fsPathParseCache, parsedFiles);
+	for(uint32_t p = 0; p < g_ptuDatabase.ptus.count; p++)
+		if(!writePolymorphicTaggedUnionFiles(fsPathOutput, g_ptuDatabase, p))
+			result = EXIT_FAILURE;
+	if(!removeStaleGeneratedFiles(fsPathOutput))
+		result = EXIT_FAILURE;
+	if(!writeKAssetFiles(fsPathOutput))
+		result = EXIT_FAILURE;
 #if 0
 	const string tempInputCodeTreeFolderName = 
 		inputCodeTreeDirectory.filename().string() + "_backup";
@@ -1339,7 +3778,8 @@ int
 				free(fileData);
 				// Recreate the original file, with kc++ modifications applied //
 				if(!writeEntireFile(outPathOriginal.c_str(), 
-				                    processedFileData.c_str()))
+				                    processedFileData.c_str(), 
+				                    processedFileData.size()))
 				{
 					fprintf(stderr, "Failed to write file '%ws'!\n", 
 					        outPathOriginal.c_str());
@@ -1353,20 +3793,6 @@ int
 			}
 		}
 	}
-#if KASSET_IMPLEMENTATION
-	// generate the kasset string database //
-	if(!g_kassets.empty())
-	{
-		const fs::path outPath = inputCodeTreeDirectory / "gen_kassets.h";
-		const string fileData = generateHeaderKAssets();
-		if(!writeEntireFile(outPath.c_str(), fileData.c_str()))
-		{
-			fprintf(stderr, "Failed to write file '%ws'!\n", 
-					outPath.c_str());
-		}
-		setFileReadOnly(outPath.c_str());
-	}
-#endif// KASSET_IMPLEMENTATION
 #endif// 0
 	// calculate the program execution time //
 	const auto timeMainEnd = chrono::high_resolution_clock::now();
@@ -1374,5 +3800,8 @@ int
 		timeMainEnd - timeMainStart);
 	const float secondsMainDuration = timeMainDuration.count() / 1000000.f;
 	printf("kcpp complete! Seconds elapsed=%f\n", secondsMainDuration);
+	if(watch)
+		return watchMain(watcher, vecFsPathInputs, fsPathOutput, parsedFiles);
+	kptuDatabaseFree(g_ptuDatabase);
 	return result;
 }
\ No newline at end of file
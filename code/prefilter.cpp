@@ -0,0 +1,252 @@
+/* The prefilter allows kcpp to skip over the vast majority of source bytes
+	without running them through the tokenizer.  Only identifiers which begin
+	with a kcpp marker (`KCPP_` / `KASSET`) & preprocessor `#` tokens can
+	affect the output, so we use vectorized byte searches to jump between
+	those candidates, while still tracking the lexer state (comments, strings
+	& character literals) exactly the same way `ktokeNext` does. */
+#include <cstddef>
+struct KPrefilterNeedles
+{
+	/* the maximum # of bytes we can search for simultaneously */
+	static const int MAX_COUNT = 8;
+	char chars[MAX_COUNT];
+	int count;
+	/* scalar fallback lookup table; non-zero for each byte in `chars` */
+	bool table[256];
+};
+static KPrefilterNeedles kprefilterMakeNeedles(const char* chars, int count)
+{
+	assert(count <= KPrefilterNeedles::MAX_COUNT);
+	KPrefilterNeedles result = {};
+	result.count = count;
+	for(int c = 0; c < count; c++)
+	{
+		result.chars[c] = chars[c];
+		result.table[static_cast<uint8_t>(chars[c])] = true;
+	}
+	return result;
+}
+/** @return the first position in [at, end) which contains any of the
+ *          `needles`, or `end` if there are none */
+static const char* kprefilterFindAny(const char* at, const char* end,
+                                     const KPrefilterNeedles& needles)
+{
+#if KTOKE_AVX2
+	__m256i vNeedles[KPrefilterNeedles::MAX_COUNT];
+	for(int n = 0; n < needles.count; n++)
+		vNeedles[n] = _mm256_set1_epi8(needles.chars[n]);
+	while(end - at >= 32)
+	{
+		const __m256i chunk =
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(at));
+		__m256i matches = _mm256_cmpeq_epi8(chunk, vNeedles[0]);
+		for(int n = 1; n < needles.count; n++)
+			matches = _mm256_or_si256(
+				matches, _mm256_cmpeq_epi8(chunk, vNeedles[n]));
+		const uint32_t mask =
+			static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+		if(mask)
+			return at + ktokeCountTrailingZeros(mask);
+		at += 32;
+	}
+#elif KTOKE_SSE2
+	__m128i vNeedles[KPrefilterNeedles::MAX_COUNT];
+	for(int n = 0; n < needles.count; n++)
+		vNeedles[n] = _mm_set1_epi8(needles.chars[n]);
+	while(end - at >= 16)
+	{
+		const __m128i chunk =
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+		__m128i matches = _mm_cmpeq_epi8(chunk, vNeedles[0]);
+		for(int n = 1; n < needles.count; n++)
+			matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, vNeedles[n]));
+		const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(matches));
+		if(mask)
+			return at + ktokeCountTrailingZeros(mask);
+		at += 16;
+	}
+#endif// KTOKE_AVX2 / KTOKE_SSE2
+	while(at < end && !needles.table[static_cast<uint8_t>(at[0])])
+		at++;
+	return at;
+}
+/** @return true if `at` points to the `K` of a kcpp marker.  `at` must be
+ *          inside of a null-terminated buffer. */
+static bool kprefilterIsMarker(const char* at)
+{
+	if(at[0] != 'K')
+		return false;
+	if(at[1] == 'C' && at[2] == 'P' && at[3] == 'P' && at[4] == '_')
+		return true;
+	if(at[1] == 'A' && at[2] == 'S' && at[3] == 'S' && at[4] == 'E' &&
+		at[5] == 'T')
+		return true;
+	return false;
+}
+/** Find the next kcpp marker in [at, end) without any regard to lexer state.
+ * This is only used to determine if there is any more work to do in a file,
+ * so false positives (markers inside of comments/strings) are okay.
+ * @return pointer to the `K` of the marker, or nullptr if there are none */
+static const char* kprefilterFindMarker(const char* at, const char* end)
+{
+#if KTOKE_AVX2
+	const __m256i vK = _mm256_set1_epi8('K');
+	const __m256i vC = _mm256_set1_epi8('C');
+	const __m256i vA = _mm256_set1_epi8('A');
+	/* we load the chunk at `at + 1` as well, so we need one extra byte */
+	while(end - at >= 33)
+	{
+		const __m256i chunk0 =
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(at));
+		const __m256i chunk1 =
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(at + 1));
+		__m256i second = _mm256_cmpeq_epi8(chunk1, vC);
+		second = _mm256_or_si256(second, _mm256_cmpeq_epi8(chunk1, vA));
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+			_mm256_and_si256(_mm256_cmpeq_epi8(chunk0, vK), second)));
+		while(mask)
+		{
+			const char*const candidate = at + ktokeCountTrailingZeros(mask);
+			if(kprefilterIsMarker(candidate))
+				return candidate;
+			mask &= mask - 1;
+		}
+		at += 32;
+	}
+#elif KTOKE_SSE2
+	const __m128i vK = _mm_set1_epi8('K');
+	const __m128i vC = _mm_set1_epi8('C');
+	const __m128i vA = _mm_set1_epi8('A');
+	/* we load the chunk at `at + 1` as well, so we need one extra byte */
+	while(end - at >= 17)
+	{
+		const __m128i chunk0 =
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+		const __m128i chunk1 =
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(at + 1));
+		__m128i second = _mm_cmpeq_epi8(chunk1, vC);
+		second = _mm_or_si128(second, _mm_cmpeq_epi8(chunk1, vA));
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(chunk0, vK), second)));
+		while(mask)
+		{
+			const char*const candidate = at + ktokeCountTrailingZeros(mask);
+			if(kprefilterIsMarker(candidate))
+				return candidate;
+			mask &= mask - 1;
+		}
+		at += 16;
+	}
+#endif// KTOKE_AVX2 / KTOKE_SSE2
+	for(; at < end; at++)
+		if(kprefilterIsMarker(at))
+			return at;
+	return nullptr;
+}
+/** Skip over source code until we reach something which must be handled by
+ * the tokenizer.  The lexer state is tracked identically to `ktokeNext`, so
+ * markers inside of comments, strings & character literals are never
+ * reported.  `at` must be a token boundary inside of a null-terminated
+ * buffer which ends at `end`.
+ * @return pointer to either a `#` token, or to the beginning of an identifier
+ *         token which contains a kcpp marker.  nullptr if the end of the
+ *         stream is reached. */
+static const char* kprefilterNextCandidate(const char* at, const char* end)
+{
+	static const KPrefilterNeedles needlesCode =
+		kprefilterMakeNeedles("/\"'#K\0", 6);
+	static const KPrefilterNeedles needlesBlockComment =
+		kprefilterMakeNeedles("*\0", 2);
+	static const KPrefilterNeedles needlesLineComment =
+		kprefilterMakeNeedles("\r\n\0", 3);
+	static const KPrefilterNeedles needlesString =
+		kprefilterMakeNeedles("\"\\\0", 3);
+	static const KPrefilterNeedles needlesCharacter =
+		kprefilterMakeNeedles("'\\\0", 3);
+	/* identifier tokens can not begin before this position, since it is
+		always a token boundary */
+	const char* tokenFloor = at;
+	for(;;)
+	{
+		at = kprefilterFindAny(at, end, needlesCode);
+		if(at >= end)
+			return nullptr;
+		switch(at[0])
+		{
+			case '\0':
+				return nullptr;
+			case '#':
+				return at;
+			case 'K':
+			{
+				if(!kprefilterIsMarker(at))
+				{
+					at++;
+					break;
+				}
+				/* determine where the identifier containing this marker
+					begins; `ktokeNext` emits leading digits as UNKNOWN tokens,
+					so the identifier starts at the first non-numeric char */
+				const char* runBegin = at;
+				while(runBegin > tokenFloor &&
+					(isAlpha(runBegin[-1]) || isNumeric(runBegin[-1])))
+				{
+					runBegin--;
+				}
+				while(isNumeric(runBegin[0]))
+					runBegin++;
+				return runBegin;
+			}
+			case '/':
+			{
+				if(at[1] == '/')
+				{
+					at = kprefilterFindAny(at + 2, end, needlesLineComment);
+				}
+				else if(at[1] == '*')
+				{
+					at += 2;
+					for(;;)
+					{
+						at = kprefilterFindAny(at, end, needlesBlockComment);
+						if(at >= end || at[0] == '\0')
+							break;
+						if(at[1] == '/')
+						{
+							at += 2;
+							break;
+						}
+						at++;
+					}
+				}
+				else
+				{
+					at++;
+				}
+				tokenFloor = at;
+			}break;
+			case '"':
+			case '\'':
+			{
+				const char terminator = at[0];
+				const KPrefilterNeedles& needles =
+					terminator == '"' ? needlesString : needlesCharacter;
+				at++;
+				for(;;)
+				{
+					at = kprefilterFindAny(at, end, needles);
+					if(at >= end || at[0] == '\0')
+						break;
+					if(at[0] == terminator)
+					{
+						at++;
+						break;
+					}
+					/* escape sequence; skip the next character (if any) */
+					at += at[1] ? 2 : 1;
+				}
+				tokenFloor = at;
+			}break;
+		}
+	}
+}
@@ -0,0 +1,133 @@
+/* Type-frequency profiles (`kcpp ... --profile file`).  A profile records how
+	many times each derived struct was dispatched to by each pure virtual
+	function of a PTU, so that the generated dispatchers can test the hottest
+	types first, without having to build the program with compiler PGO.
+
+	The profile is a text file with one record per line:
+		ptu_identifier function_identifier derived_struct_identifier call_count
+	Empty lines & lines which begin with `#` are ignored. */
+/* if a single type receives at least this share of a function's calls, it is
+	tested for before the switch */
+static const double KPROFILE_FAST_PATH_SHARE = 0.9;
+/* if the hottest type receives at least this share of a function's calls, its
+	case is marked [[likely]] */
+static const double KPROFILE_LIKELY_SHARE = 0.5;
+struct KProfileRecord
+{
+	KSymbol ptu;
+	KSymbol function;
+	KSymbol derivedStruct;
+	uint64_t callCount;
+};
+struct KProfile
+{
+	/* sorted by symbols so that records can be found with a binary search;
+		symbol values never affect the generated code, only the counts do */
+	vector<KProfileRecord> records;
+	bool loaded;
+};
+static KProfile g_profile;
+static bool kprofileRecordLess(const KProfileRecord& a,
+                               const KProfileRecord& b)
+{
+	if(a.ptu != b.ptu)
+		return a.ptu < b.ptu;
+	if(a.function != b.function)
+		return a.function < b.function;
+	return a.derivedStruct < b.derivedStruct;
+}
+/** @return false if the profile could not be read or is malformed */
+static bool kprofileLoad(const fs::path& fsPathProfile)
+{
+	std::error_code errorCode;
+	const uintmax_t fileSize = fs::file_size(fsPathProfile, errorCode);
+	if(errorCode)
+	{
+		fprintf(stderr, "Failed to open profile '%ws'!\n",
+		        fsPathProfile.c_str());
+		return false;
+	}
+	char*const fileData = readEntireFile(fsPathProfile.c_str(), fileSize);
+	if(!fileData)
+		return false;
+	bool success = true;
+	size_t lineNumber = 0;
+	for(char* line = fileData; line && *line; )
+	{
+		lineNumber++;
+		char*const lineEnd = strchr(line, '\n');
+		if(lineEnd)
+			*lineEnd = '\0';
+		/* split the line into whitespace-separated fields */
+		string_view fields[4];
+		size_t fieldCount = 0;
+		for(char* c = line; *c && *c != '#'; )
+		{
+			if(isspace(static_cast<uint8_t>(*c)))
+			{
+				c++;
+				continue;
+			}
+			char* fieldEnd = c;
+			while(*fieldEnd && !isspace(static_cast<uint8_t>(*fieldEnd)))
+				fieldEnd++;
+			if(fieldCount < 4)
+				fields[fieldCount] = string_view(c, fieldEnd - c);
+			fieldCount++;
+			c = fieldEnd;
+		}
+		line = lineEnd ? lineEnd + 1 : nullptr;
+		if(fieldCount == 0)
+			continue;
+		char* callCountEnd = nullptr;
+		const string callCountStr(fields[3]);
+		const uint64_t callCount = fieldCount == 4
+			? strtoull(callCountStr.c_str(), &callCountEnd, 10) : 0;
+		if(fieldCount != 4 || !callCountEnd || *callCountEnd)
+		{
+			fprintf(stderr, "'%ws'(%zu): malformed profile record!\n",
+			        fsPathProfile.c_str(), lineNumber);
+			success = false;
+			continue;
+		}
+		g_profile.records.push_back(
+			{ .ptu           = ksymbolIntern(fields[0])
+			, .function      = ksymbolIntern(fields[1])
+			, .derivedStruct = ksymbolIntern(fields[2])
+			, .callCount     = callCount });
+	}
+	free(fileData);
+	/* profiles of several runs may simply be concatenated, so the counts of 
+		duplicate records are summed */
+	vector<KProfileRecord>& records = g_profile.records;
+	std::sort(records.begin(), records.end(), kprofileRecordLess);
+	size_t uniqueCount = 0;
+	for(size_t r = 0; r < records.size(); r++)
+	{
+		if(uniqueCount > 0 && 
+			!kprofileRecordLess(records[uniqueCount - 1], records[r]))
+			records[uniqueCount - 1].callCount += records[r].callCount;
+		else
+			records[uniqueCount++] = records[r];
+	}
+	records.resize(uniqueCount);
+	g_profile.loaded = success;
+	return success;
+}
+/** @return the number of times `derivedStruct` was dispatched to by
+ *          `function`, or 0 if the profile doesn't contain this record */
+static uint64_t kprofileCallCount(KSymbol ptu, KSymbol function,
+                                  KSymbol derivedStruct)
+{
+	const KProfileRecord key =
+		{ .ptu           = ptu
+		, .function      = function
+		, .derivedStruct = derivedStruct
+		, .callCount     = 0 };
+	const auto it = std::lower_bound(g_profile.records.begin(),
+	                                 g_profile.records.end(), key,
+	                                 kprofileRecordLess);
+	if(it == g_profile.records.end() || kprofileRecordLess(key, *it))
+		return 0;
+	return it->callCount;
+}
@@ -1,4 +1,27 @@
 #include <cstdint>
+#include <array>
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define KTOKE_AVX2 1
+	#define KTOKE_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define KTOKE_SSE2 1
+#endif
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+static int ktokeCountTrailingZeros(uint32_t bits)
+{
+#if defined(_MSC_VER)
+	unsigned long result;
+	_BitScanForward(&result, bits);
+	return static_cast<int>(result);
+#else
+	return __builtin_ctz(bits);
+#endif
+}
 enum class KTokenType : int8_t
 	{ PAREN_OPEN
 	, PAREN_CLOSE
@@ -28,33 +51,232 @@ struct KTokenizer
 {
 	const char* at;
 };
-static bool isEndOfLine(char c)
+/* every byte of the input is classified with a single table lookup, which
+	also tells `ktokeNext` how to dispatch the token starting at that byte */
+enum KTokeCharFlags : uint8_t
+	{ KTOKE_CHAR_END_OF_LINE = 1<<0
+	, KTOKE_CHAR_WHITESPACE  = 1<<1
+	, KTOKE_CHAR_ALPHA       = 1<<2
+	, KTOKE_CHAR_NUMERIC     = 1<<3 };
+enum class KTokeDispatch : uint8_t
+	{ SINGLE_CHAR
+	, WHITESPACE
+	, IDENTIFIER
+	, SLASH
+	, QUOTE };
+struct KTokeCharInfo
+{
+	uint8_t flags;
+	KTokeDispatch dispatch;
+	/* the type of the token which begins with this character */
+	KTokenType tokenType;
+};
+static constexpr std::array<KTokeCharInfo, 256> ktokeBuildCharInfoTable()
 {
-	const bool result = 
-		c == '\r' ||
-		c == '\n';
+	std::array<KTokeCharInfo, 256> result = {};
+	for(int c = 0; c < 256; c++)
+	{
+		result[c] =
+			{ .flags     = 0
+			, .dispatch  = KTokeDispatch::SINGLE_CHAR
+			, .tokenType = KTokenType::UNKNOWN };
+		if(c == '\r' || c == '\n')
+			result[c].flags |= KTOKE_CHAR_END_OF_LINE;
+		if(c == ' ' || c == '\t' || c == '\r' || c == '\n')
+		{
+			result[c].flags    |= KTOKE_CHAR_WHITESPACE;
+			result[c].dispatch  = KTokeDispatch::WHITESPACE;
+			result[c].tokenType = KTokenType::WHITESPACE;
+		}
+		if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+		{
+			result[c].flags    |= KTOKE_CHAR_ALPHA;
+			result[c].dispatch  = KTokeDispatch::IDENTIFIER;
+			result[c].tokenType = KTokenType::IDENTIFIER;
+		}
+		if(c >= '0' && c <= '9')
+			result[c].flags |= KTOKE_CHAR_NUMERIC;
+	}
+	result['/'].dispatch   = KTokeDispatch::SLASH;
+	result['"'].dispatch   = KTokeDispatch::QUOTE;
+	result['"'].tokenType  = KTokenType::STRING;
+	result['\''].dispatch  = KTokeDispatch::QUOTE;
+	result['\''].tokenType = KTokenType::CHARACTER;
+	result['\0'].tokenType = KTokenType::END_OF_STREAM;
+	result['('].tokenType  = KTokenType::PAREN_OPEN;
+	result[')'].tokenType  = KTokenType::PAREN_CLOSE;
+	result[':'].tokenType  = KTokenType::COLON;
+	result[','].tokenType  = KTokenType::COMMA;
+	result[';'].tokenType  = KTokenType::SEMICOLON;
+	result['*'].tokenType  = KTokenType::ASTERISK;
+	result['['].tokenType  = KTokenType::BRACKET_OPEN;
+	result[']'].tokenType  = KTokenType::BRACKET_CLOSE;
+	result['{'].tokenType  = KTokenType::BRACE_OPEN;
+	result['}'].tokenType  = KTokenType::BRACE_CLOSE;
+	result['#'].tokenType  = KTokenType::HASH_TAG;
 	return result;
 }
+static constexpr std::array<KTokeCharInfo, 256> g_ktokeCharInfo =
+	ktokeBuildCharInfoTable();
+static uint8_t ktokeCharFlags(char c)
+{
+	return g_ktokeCharInfo[static_cast<uint8_t>(c)].flags;
+}
+static bool isEndOfLine(char c)
+{
+	return ktokeCharFlags(c) & KTOKE_CHAR_END_OF_LINE;
+}
 static bool isWhitespace(char c)
 {
-	const bool result = 
-		c == ' ' ||
-		c == '\t' ||
-		isEndOfLine(c);
-	return result;
+	return ktokeCharFlags(c) & KTOKE_CHAR_WHITESPACE;
+}
+static bool isAlpha(char c)
+{
+	return ktokeCharFlags(c) & KTOKE_CHAR_ALPHA;
+}
+static bool isNumeric(char c)
+{
+	return ktokeCharFlags(c) & KTOKE_CHAR_NUMERIC;
+}
+static const int KTOKE_SHORT_RUN_LENGTH = 8;
+#if KTOKE_SSE2
+/* Vectorized loads read up to 15 bytes past the end of a token.  The input is
+	only guaranteed to be valid up to its null-terminator, so we only use them
+	when the load can not cross into the next (possibly unmapped) page. */
+static bool ktokeCanLoad16(const char* at)
+{
+	return (reinterpret_cast<uintptr_t>(at) & 4095) <= 4096 - 16;
+}
+#endif// KTOKE_SSE2
+/** @return the first character at or after `at` which is not whitespace */
+static const char* ktokeSkipWhitespace(const char* at)
+{
+	/* most runs are short, so check the first few characters one at a time 
+		before switching to vectorized loads */
+	for(int c = 0; c < KTOKE_SHORT_RUN_LENGTH; c++, at++)
+		if(!isWhitespace(at[0]))
+			return at;
+#if KTOKE_SSE2
+	const __m128i vSpace   = _mm_set1_epi8(' ');
+	const __m128i vTab     = _mm_set1_epi8('\t');
+	const __m128i vReturn  = _mm_set1_epi8('\r');
+	const __m128i vNewLine = _mm_set1_epi8('\n');
+#endif// KTOKE_SSE2
+	for(;;)
+	{
+#if KTOKE_SSE2
+		if(ktokeCanLoad16(at))
+		{
+			const __m128i chunk =
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+			const __m128i whitespace =
+				_mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, vSpace),
+					             _mm_cmpeq_epi8(chunk, vTab)),
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, vReturn),
+					             _mm_cmpeq_epi8(chunk, vNewLine)));
+			const uint32_t mask =
+				~static_cast<uint32_t>(_mm_movemask_epi8(whitespace)) & 0xFFFF;
+			if(mask)
+				return at + ktokeCountTrailingZeros(mask);
+			at += 16;
+			continue;
+		}
+#endif// KTOKE_SSE2
+		if(!isWhitespace(at[0]))
+			return at;
+		at++;
+	}
+}
+/** @return the first character at or after `at` which can not be part of an
+ *          identifier */
+static const char* ktokeSkipIdentifierChars(const char* at)
+{
+	for(int c = 0; c < KTOKE_SHORT_RUN_LENGTH; c++, at++)
+		if(!(ktokeCharFlags(at[0]) & (KTOKE_CHAR_ALPHA | KTOKE_CHAR_NUMERIC)))
+			return at;
+#if KTOKE_SSE2
+	const __m128i vCaseBit     = _mm_set1_epi8(0x20);
+	const __m128i vBeforeLower = _mm_set1_epi8('a' - 1);
+	const __m128i vAfterLower  = _mm_set1_epi8('z' + 1);
+	const __m128i vBeforeDigit = _mm_set1_epi8('0' - 1);
+	const __m128i vAfterDigit  = _mm_set1_epi8('9' + 1);
+	const __m128i vUnderscore  = _mm_set1_epi8('_');
+#endif// KTOKE_SSE2
+	for(;;)
+	{
+#if KTOKE_SSE2
+		if(ktokeCanLoad16(at))
+		{
+			const __m128i chunk =
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+			/* setting the case bit maps 'A'-'Z' onto 'a'-'z'; bytes >= 0x80
+				compare as negative, so they are never classified as alpha */
+			const __m128i lower = _mm_or_si128(chunk, vCaseBit);
+			const __m128i alpha =
+				_mm_and_si128(_mm_cmpgt_epi8(lower, vBeforeLower),
+				              _mm_cmplt_epi8(lower, vAfterLower));
+			const __m128i numeric =
+				_mm_and_si128(_mm_cmpgt_epi8(chunk, vBeforeDigit),
+				              _mm_cmplt_epi8(chunk, vAfterDigit));
+			const __m128i identifier =
+				_mm_or_si128(_mm_or_si128(alpha, numeric),
+				             _mm_cmpeq_epi8(chunk, vUnderscore));
+			const uint32_t mask =
+				~static_cast<uint32_t>(_mm_movemask_epi8(identifier)) & 0xFFFF;
+			if(mask)
+				return at + ktokeCountTrailingZeros(mask);
+			at += 16;
+			continue;
+		}
+#endif// KTOKE_SSE2
+		if(!(ktokeCharFlags(at[0]) & (KTOKE_CHAR_ALPHA | KTOKE_CHAR_NUMERIC)))
+			return at;
+		at++;
+	}
+}
+/** @return the first character at or after `at` which is equal to `c0`, `c1` 
+ *          or `c2`.  The caller must include '\0' in the search set. */
+static const char* ktokeFindAny(const char* at, char c0, char c1, char c2)
+{
+#if KTOKE_SSE2
+	const __m128i v0 = _mm_set1_epi8(c0);
+	const __m128i v1 = _mm_set1_epi8(c1);
+	const __m128i v2 = _mm_set1_epi8(c2);
+#endif// KTOKE_SSE2
+	for(;;)
+	{
+#if KTOKE_SSE2
+		if(ktokeCanLoad16(at))
+		{
+			const __m128i chunk = 
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+			const __m128i matches = 
+				_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, v0), 
+				                          _mm_cmpeq_epi8(chunk, v1)), 
+				             _mm_cmpeq_epi8(chunk, v2));
+			const uint32_t mask = 
+				static_cast<uint32_t>(_mm_movemask_epi8(matches));
+			if(mask)
+				return at + ktokeCountTrailingZeros(mask);
+			at += 16;
+			continue;
+		}
+#endif// KTOKE_SSE2
+		if(at[0] == c0 || at[0] == c1 || at[0] == c2)
+			return at;
+		at++;
+	}
 }
 static KToken ktokeParseWhitespace(KTokenizer& tokenizer)
 {
+	const char*const whitespaceEnd = ktokeSkipWhitespace(tokenizer.at);
 	KToken result = {
 		.type = KTokenType::WHITESPACE,
-		.textLength = 0,
+		.textLength = static_cast<int>(whitespaceEnd - tokenizer.at),
 		.text = tokenizer.at
 	};
-	while(isWhitespace(tokenizer.at[0]))
-	{
-		tokenizer.at++;
-		result.textLength++;
-	}
+	tokenizer.at = whitespaceEnd;
 	return result;
 }
 static KToken ktokeParseComment(KTokenizer& tokenizer)
@@ -66,59 +288,61 @@ static KToken ktokeParseComment(KTokenizer& tokenizer)
 	};
 	if(tokenizer.at[0] == '/' && tokenizer.at[1] == '/')
 	{
-		tokenizer.at += 2;
-		result.textLength += 2;
-		while(tokenizer.at[0] && !isEndOfLine(tokenizer.at[0]))
-		{
-			tokenizer.at++;
-			result.textLength++;
-		}
-		return result;
+		tokenizer.at = ktokeFindAny(tokenizer.at + 2, '\r', '\n', '\0');
 	}
 	else if(tokenizer.at[0] == '/' && tokenizer.at[1] == '*')
 	{
 		tokenizer.at += 2;
-		result.textLength += 2;
-		while(tokenizer.at[0] && 
-			!(tokenizer.at[0] == '*' && tokenizer.at[1] == '/'))
+		for(;;)
 		{
+			tokenizer.at = ktokeFindAny(tokenizer.at, '*', '\0', '\0');
+			if(tokenizer.at[0] == '\0')
+				break;
+			if(tokenizer.at[1] == '/')
+			{
+				tokenizer.at += 2;
+				break;
+			}
 			tokenizer.at++;
-			result.textLength++;
 		}
-		if(tokenizer.at[0] == '*')
-		{
-			tokenizer.at += 2;
-			result.textLength += 2;
-		}
-		return result;
 	}
+	result.textLength = static_cast<int>(tokenizer.at - result.text);
 	return result;
 }
-static bool isAlpha(char c)
+static KToken ktokeParseIdentifier(KTokenizer& tokenizer)
 {
-	const bool result = 
-		(c >= 'a' && c <= 'z') ||
-		(c >= 'A' && c <= 'Z') ||
-		c == '_';
-	return result;
-}
-static bool isNumeric(char c)
-{
-	const bool result = (c >= '0' && c <= '9');
+	const char*const identifierEnd = ktokeSkipIdentifierChars(tokenizer.at + 1);
+	KToken result = {
+		.type = KTokenType::IDENTIFIER,
+		.textLength = static_cast<int>(identifierEnd - tokenizer.at),
+		.text = tokenizer.at
+	};
+	tokenizer.at = identifierEnd;
 	return result;
 }
-KToken ktokeParseIdentifier(KTokenizer& tokenizer)
+/** parse a string or character literal; the token text excludes the quotes */
+static KToken ktokeParseQuoted(KTokenizer& tokenizer, KTokenType type, 
+                               char quote)
 {
+	tokenizer.at++;
 	KToken result = {
-		.type = KTokenType::IDENTIFIER,
-		.textLength = 1,
+		.type = type,
+		.textLength = 0,
 		.text = tokenizer.at
 	};
-	tokenizer.at++;
-	while(isAlpha(tokenizer.at[0]) || isNumeric(tokenizer.at[0]))
+	for(;;)
+	{
+		tokenizer.at = ktokeFindAny(tokenizer.at, quote, '\\', '\0');
+		if(tokenizer.at[0] != '\\')
+			break;
+		/* skip the escaped character, unless it is the null-terminator */
+		tokenizer.at += tokenizer.at[1] ? 2 : 1;
+	}
+	result.textLength = static_cast<int>(tokenizer.at - result.text);
+	// consume the final quote
+	if(tokenizer.at[0] == quote)
 	{
 		tokenizer.at++;
-		result.textLength++;
 	}
 	return result;
 }
@@ -129,98 +353,28 @@ KToken ktokeParseNumber(KTokenizer& tokenizer)
 #endif // 0
 static KToken ktokeNext(KTokenizer& tokenizer)
 {
-	if(isWhitespace(tokenizer.at[0]))
-	{
+	const KTokeCharInfo& charInfo = 
+		g_ktokeCharInfo[static_cast<uint8_t>(tokenizer.at[0])];
+	/* dispatch classes are tested in order of how frequently they occur in 
+		typical source code, since well-predicted branches are cheaper than 
+		the indirect jump of a switch here */
+	if(charInfo.dispatch == KTokeDispatch::IDENTIFIER)
+		return ktokeParseIdentifier(tokenizer);
+	if(charInfo.dispatch == KTokeDispatch::WHITESPACE)
 		return ktokeParseWhitespace(tokenizer);
-	}
+	if(charInfo.dispatch == KTokeDispatch::QUOTE)
+		return ktokeParseQuoted(tokenizer, charInfo.tokenType, tokenizer.at[0]);
+	if(charInfo.dispatch == KTokeDispatch::SLASH && 
+		(tokenizer.at[1] == '/' || tokenizer.at[1] == '*'))
+		return ktokeParseComment(tokenizer);
+	/* all other tokens are a single character, including UNKNOWN tokens such 
+		as a division operator, which we just skip over */
 	KToken result = {
-		.type = KTokenType::UNKNOWN,
+		.type = charInfo.tokenType,
 		.textLength = 1,
 		.text = tokenizer.at
 	};
-	switch(tokenizer.at[0])
-	{
-		case '\0': result.type = KTokenType::END_OF_STREAM; tokenizer.at++; break;
-		case '(':  result.type = KTokenType::PAREN_OPEN;    tokenizer.at++; break;
-		case ')':  result.type = KTokenType::PAREN_CLOSE;   tokenizer.at++; break;
-		case ':':  result.type = KTokenType::COLON;         tokenizer.at++; break;
-		case ',':  result.type = KTokenType::COMMA;         tokenizer.at++; break;
-		case ';':  result.type = KTokenType::SEMICOLON;     tokenizer.at++; break;
-		case '*':  result.type = KTokenType::ASTERISK;      tokenizer.at++; break;
-		case '[':  result.type = KTokenType::BRACKET_OPEN;  tokenizer.at++; break;
-		case ']':  result.type = KTokenType::BRACKET_CLOSE; tokenizer.at++; break;
-		case '{':  result.type = KTokenType::BRACE_OPEN;    tokenizer.at++; break;
-		case '}':  result.type = KTokenType::BRACE_CLOSE;   tokenizer.at++; break;
-		case '#':  result.type = KTokenType::HASH_TAG;      tokenizer.at++; break;
-		case '/':
-		{
-			if(tokenizer.at[1] && 
-				(tokenizer.at[1] == '/' || tokenizer.at[1] == '*'))
-			{
-				return ktokeParseComment(tokenizer);
-			}
-			// otherwise, this is something else like a division operator. Skip.
-			tokenizer.at++;
-		}break;
-		case '"': 
-		{
-			result.type = KTokenType::STRING;
-			result.textLength = 0;
-			tokenizer.at++;
-			result.text = tokenizer.at;
-			while(tokenizer.at[0] && tokenizer.at[0] != '"')
-			{
-				if(tokenizer.at[0] == '\\' && tokenizer.at[1])
-				{
-					tokenizer.at++; result.textLength++;
-				}
-				tokenizer.at++; result.textLength++;
-			}
-			// consume the final '"' 
-			if(tokenizer.at[0] == '"')
-			{
-				tokenizer.at++;
-			}
-		}break;
-		case '\'':
-		{
-			result.type = KTokenType::CHARACTER;
-			result.textLength = 0;
-			tokenizer.at++;
-			result.text = tokenizer.at;
-			while(tokenizer.at[0] && tokenizer.at[0] != '\'')
-			{
-				if(tokenizer.at[0] == '\\' && tokenizer.at[1])
-				{
-					tokenizer.at++; result.textLength++;
-				}
-				tokenizer.at++; result.textLength++;
-			}
-			// consume the final '\''
-			if(tokenizer.at[0] == '\'')
-			{
-				tokenizer.at++;
-			}
-		}break;
-		default:
-		{
-			if(isAlpha(tokenizer.at[0]))
-			{
-				return ktokeParseIdentifier(tokenizer);
-			}
-#if 0
-			else if(isNumeric(tokenizer.at[0]))
-			{
-				return ktokeParseNumber(tokenizer);
-			}
-#endif// 0
-			else 
-			{
-				// skip our UNKNOWN token character
-				tokenizer.at++;
-			}
-		}break;
-	}
+	tokenizer.at++;
 	return result;
 }
 static bool ktokeEquals(const KToken& token, const char* cStr)
@@ -254,4 +408,4 @@ static KToken kcppRequireToken(KTokenizer& tokenizer, KTokenType tokenType)
 		}
 	} while(token.type != tokenType);
 	return token;
-}
\ No newline at end of file
+}
@@ -0,0 +1,384 @@
+/* Resident watch mode (`kcpp ... --watch`).  After the initial run, kcpp keeps
+	every file's parse events in memory & subscribes to file system change
+	notifications on the input directories (ReadDirectoryChangesW on Windows,
+	inotify on Linux).  When files change, only those files are re-parsed; the
+	PTU database is then re-merged from the in-memory events & only the PTUs
+	which the changed files contributed to (before or after the change) are
+	regenerated. */
+#include <cerrno>
+#include <memory>
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/inotify.h>
+#endif// !defined(_WIN32)
+/* editors usually save a file with a burst of several notifications, so we
+	wait until the input directories have been quiet for this long before
+	processing a batch of changes */
+static const int KWATCH_DEBOUNCE_MILLISECONDS = 20;
+struct KWatcher
+{
+#if defined(_WIN32)
+	struct Directory
+	{
+		fs::path path;
+		HANDLE hDirectory;
+		OVERLAPPED overlapped;
+		/* ReadDirectoryChangesW requires a DWORD-aligned buffer */
+		DWORD buffer[16*1024];
+	};
+	vector<std::unique_ptr<Directory>> directories;
+#else
+	int inotifyFd;
+	map<int, fs::path> watchDescriptorPaths;
+#endif// defined(_WIN32)
+};
+#if defined(_WIN32)
+static bool kwatchIssueRead(KWatcher::Directory& directory)
+{
+	ResetEvent(directory.overlapped.hEvent);
+	const DWORD notifyFilter =
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+		FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+	if(!ReadDirectoryChangesW(directory.hDirectory, directory.buffer,
+	                          sizeof(directory.buffer), TRUE, notifyFilter,
+	                          nullptr, &directory.overlapped, nullptr))
+	{
+		fprintf(stderr, "Failed to watch '%ws'! getlasterror=%i\n",
+		        directory.path.c_str(), GetLastError());
+		return false;
+	}
+	return true;
+}
+static bool kwatchOpen(KWatcher& watcher, const vector<fs::path>& vecFsPaths)
+{
+	if(vecFsPaths.size() > MAXIMUM_WAIT_OBJECTS)
+	{
+		fprintf(stderr, "Can't watch more than %i input directories!\n",
+		        MAXIMUM_WAIT_OBJECTS);
+		return false;
+	}
+	for(const fs::path& fsPath : vecFsPaths)
+	{
+		auto directory = std::make_unique<KWatcher::Directory>();
+		directory->path = fsPath;
+		directory->hDirectory =
+			CreateFileW(fsPath.c_str(), FILE_LIST_DIRECTORY,
+			            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			            nullptr, OPEN_EXISTING,
+			            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+			            NULL);
+		if(directory->hDirectory == INVALID_HANDLE_VALUE)
+		{
+			fprintf(stderr, "Failed to open directory '%ws'! "
+			        "getlasterror=%i\n", fsPath.c_str(), GetLastError());
+			return false;
+		}
+		directory->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE,
+		                                            nullptr);
+		if(!directory->overlapped.hEvent || !kwatchIssueRead(*directory))
+		{
+			CloseHandle(directory->hDirectory);
+			return false;
+		}
+		watcher.directories.push_back(std::move(directory));
+	}
+	return true;
+}
+/** @return false if no notifications arrived within `timeoutMilliseconds` */
+static bool kwatchRead(KWatcher& watcher, DWORD timeoutMilliseconds,
+                       set<fs::path>& outChangedPaths, bool& outRescan)
+{
+	HANDLE hEvents[MAXIMUM_WAIT_OBJECTS];
+	for(size_t d = 0; d < watcher.directories.size(); d++)
+		hEvents[d] = watcher.directories[d]->overlapped.hEvent;
+	const DWORD waitResult =
+		WaitForMultipleObjects(static_cast<DWORD>(watcher.directories.size()),
+		                       hEvents, FALSE, timeoutMilliseconds);
+	if(waitResult >= WAIT_OBJECT_0 + watcher.directories.size())
+		return false;
+	KWatcher::Directory& directory =
+		*watcher.directories[waitResult - WAIT_OBJECT_0];
+	DWORD bytesTransferred = 0;
+	if(!GetOverlappedResult(directory.hDirectory, &directory.overlapped,
+	                        &bytesTransferred, FALSE) ||
+		bytesTransferred == 0)
+	{
+		/* the notification buffer overflowed, so we don't know what
+			changed */
+		outRescan = true;
+	}
+	else
+	{
+		const char* at = reinterpret_cast<const char*>(directory.buffer);
+		for(;;)
+		{
+			const FILE_NOTIFY_INFORMATION*const notifyInfo =
+				reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(at);
+			outChangedPaths.insert(
+				directory.path / std::wstring(
+					notifyInfo->FileName,
+					notifyInfo->FileNameLength / sizeof(WCHAR)));
+			if(notifyInfo->NextEntryOffset == 0)
+				break;
+			at += notifyInfo->NextEntryOffset;
+		}
+	}
+	if(!kwatchIssueRead(directory))
+		outRescan = true;
+	return true;
+}
+#else
+static const uint32_t KWATCH_INOTIFY_MASK =
+	IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+static void kwatchAddDirectory(KWatcher& watcher, const fs::path& fsPath)
+{
+	const int watchDescriptor =
+		inotify_add_watch(watcher.inotifyFd, fsPath.c_str(),
+		                  KWATCH_INOTIFY_MASK);
+	if(watchDescriptor < 0)
+	{
+		fprintf(stderr, "Failed to watch '%ws'! errno=%i\n",
+		        fsPath.c_str(), errno);
+		return;
+	}
+	watcher.watchDescriptorPaths[watchDescriptor] = fsPath;
+}
+/* inotify is not recursive, so each sub-directory needs its own watch */
+static void kwatchAddDirectoryTree(KWatcher& watcher, const fs::path& fsPath)
+{
+	kwatchAddDirectory(watcher, fsPath);
+	std::error_code errorCode;
+	for(fs::recursive_directory_iterator it(fsPath, errorCode), end;
+		!errorCode && it != end; it.increment(errorCode))
+	{
+		if(it->is_directory())
+			kwatchAddDirectory(watcher, it->path());
+	}
+}
+static bool kwatchOpen(KWatcher& watcher, const vector<fs::path>& vecFsPaths)
+{
+	watcher.inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(watcher.inotifyFd < 0)
+	{
+		fprintf(stderr, "Failed to initialize inotify! errno=%i\n", errno);
+		return false;
+	}
+	for(const fs::path& fsPath : vecFsPaths)
+		kwatchAddDirectoryTree(watcher, fsPath);
+	return !watcher.watchDescriptorPaths.empty();
+}
+/** @return false if no notifications arrived within `timeoutMilliseconds` */
+static bool kwatchRead(KWatcher& watcher, int timeoutMilliseconds,
+                       set<fs::path>& outChangedPaths, bool& outRescan)
+{
+	pollfd pollFd = {};
+	pollFd.fd     = watcher.inotifyFd;
+	pollFd.events = POLLIN;
+	if(poll(&pollFd, 1, timeoutMilliseconds) <= 0)
+		return false;
+	alignas(inotify_event) char buffer[64*1024];
+	for(;;)
+	{
+		const ssize_t bytesRead = read(watcher.inotifyFd, buffer,
+		                               sizeof(buffer));
+		if(bytesRead <= 0)
+			break;
+		for(const char* at = buffer; at < buffer + bytesRead; )
+		{
+			const inotify_event*const event =
+				reinterpret_cast<const inotify_event*>(at);
+			at += sizeof(inotify_event) + event->len;
+			if(event->mask & IN_Q_OVERFLOW)
+			{
+				outRescan = true;
+				continue;
+			}
+			if(event->mask & IN_IGNORED)
+			{
+				watcher.watchDescriptorPaths.erase(event->wd);
+				continue;
+			}
+			auto wdIt = watcher.watchDescriptorPaths.find(event->wd);
+			if(wdIt == watcher.watchDescriptorPaths.end() || event->len == 0)
+				continue;
+			const fs::path fsPath = wdIt->second / event->name;
+			if((event->mask & IN_ISDIR) &&
+				(event->mask & (IN_CREATE | IN_MOVED_TO)))
+				kwatchAddDirectoryTree(watcher, fsPath);
+			outChangedPaths.insert(fsPath);
+		}
+	}
+	return true;
+}
+#endif// defined(_WIN32)
+/** Block until something in the watched directories changes, then collect
+ * changes until the directories have been quiet for a moment.
+ * @param outRescan set if the OS dropped notifications, in which case every
+ *                  input file must be considered changed */
+static void kwatchWait(KWatcher& watcher, set<fs::path>& outChangedPaths,
+                       bool& outRescan)
+{
+#if defined(_WIN32)
+	while(!kwatchRead(watcher, INFINITE, outChangedPaths, outRescan));
+#else
+	while(!kwatchRead(watcher, -1, outChangedPaths, outRescan));
+#endif// defined(_WIN32)
+	while(kwatchRead(watcher, KWATCH_DEBOUNCE_MILLISECONDS,
+	                 outChangedPaths, outRescan));
+}
+/** @return true if `fsPath` is one of kcpp's own output files, which must not
+ *          trigger a regeneration if the output directory is watched */
+static bool kwatchIsIgnoredPath(const fs::path& fsPath)
+{
+	return fsPath.filename() == KCACHE_FILE_NAME ||
+		fsPath.extension() == TEMP_FILE_EXTENSION;
+}
+static void kwatchCollectAffectedOutputs(const ParsedFile& parsedFile,
+                                         set<TaggedUnionStructIdentifier>&
+                                             outPtuIdentifiers,
+                                         bool& outKAssetsAffected)
+{
+	for(const PolymorphicTaggedUnionParseEvent& event : parsedFile.ptuEvents)
+		outPtuIdentifiers.insert(event.ptuIdentifier);
+	if(!parsedFile.kassets.empty())
+		outKAssetsAffected = true;
+}
+static int watchMain(KWatcher& watcher, const vector<fs::path>& vecFsPathInputs,
+                     const fs::path& fsPathOutput,
+                     vector<ParsedFile>& parsedFiles)
+{
+	printf("kcpp: watching for changes...\n");
+	for(;;)
+	{
+		set<fs::path> changedPaths;
+		bool rescan = false;
+		kwatchWait(watcher, changedPaths, rescan);
+		const auto timeStart = chrono::high_resolution_clock::now();
+		if(rescan)
+		{
+			if(g_verbose)
+				printf("kcpp: change notifications were lost; rescanning\n");
+			for(const ParsedFile& parsedFile : parsedFiles)
+				changedPaths.insert(parsedFile.path);
+			changedPaths.insert(vecFsPathInputs.begin(), vecFsPathInputs.end());
+		}
+		/* PTUs which the changed files contribute to, either before or after
+			the change, are the only ones whose generated code can change */
+		set<TaggedUnionStructIdentifier> affectedPtus;
+		bool kassetsAffected = false;
+		vector<size_t> reparseFileIndices;
+		auto updateFile = [&](const fs::directory_entry& fsDirEnt)
+		{
+			if(kwatchIsIgnoredPath(fsDirEnt.path()))
+				return;
+			const uintmax_t fileSize = fsDirEnt.file_size();
+			const int64_t lastWriteTime = kcacheLastWriteTime(fsDirEnt);
+			auto fileIt = std::find_if(parsedFiles.begin(), parsedFiles.end(),
+				[&fsDirEnt](const ParsedFile& parsedFile)
+				{ return parsedFile.path == fsDirEnt.path(); });
+			if(fileIt == parsedFiles.end())
+			{
+				fileIt = parsedFiles.insert(parsedFiles.end(),
+					{ .path = fsDirEnt.path() });
+			}
+			else if(!fileIt->readFailure && fileIt->fileSize == fileSize &&
+				fileIt->lastWriteTime == lastWriteTime)
+			{
+				return;
+			}
+			kwatchCollectAffectedOutputs(*fileIt, affectedPtus,
+			                             kassetsAffected);
+			/* nothing refers to the old strings once the PTU database is 
+				rebuilt below */
+			freeParsedFileStrings(*fileIt);
+			*fileIt =
+				{ .path          = fsDirEnt.path()
+				, .fileSize      = fileSize
+				, .lastWriteTime = lastWriteTime };
+			const size_t f = fileIt - parsedFiles.begin();
+			if(std::find(reparseFileIndices.begin(), reparseFileIndices.end(),
+			             f) == reparseFileIndices.end())
+				reparseFileIndices.push_back(f);
+		};
+		size_t removedFileCount = 0;
+		for(const fs::path& changedPath : changedPaths)
+		{
+			std::error_code errorCode;
+			const fs::directory_entry fsDirEnt(changedPath, errorCode);
+			if(!errorCode && fsDirEnt.is_regular_file())
+			{
+				updateFile(fsDirEnt);
+			}
+			else if(!errorCode && fsDirEnt.is_directory())
+			{
+				/* a directory was created or moved into the input tree */
+				for(fs::recursive_directory_iterator it(changedPath, errorCode),
+						end;
+					!errorCode && it != end; it.increment(errorCode))
+				{
+					if(it->is_regular_file())
+						updateFile(*it);
+				}
+			}
+			else
+			{
+				/* the file (or the entire directory containing it) was
+					deleted or moved out of the input tree */
+				fs::path::string_type changedDirectory = changedPath.native();
+				changedDirectory.push_back(fs::path::preferred_separator);
+				for(size_t f = 0; f < parsedFiles.size(); )
+				{
+					const fs::path::string_type& filePath =
+						parsedFiles[f].path.native();
+					if(filePath != changedPath.native() &&
+						filePath.rfind(changedDirectory, 0) != 0)
+					{
+						f++;
+						continue;
+					}
+					kwatchCollectAffectedOutputs(parsedFiles[f], affectedPtus,
+					                             kassetsAffected);
+					freeParsedFileStrings(parsedFiles[f]);
+					parsedFiles.erase(parsedFiles.begin() + f);
+					removedFileCount++;
+					/* the erasure shifts all the indices after `f` */
+					for(size_t& r : reparseFileIndices)
+						if(r > f)
+							r--;
+				}
+			}
+		}
+		if(reparseFileIndices.empty() && removedFileCount == 0)
+			continue;
+		for(const size_t f : reparseFileIndices)
+		{
+			if(g_verbose)
+				printf("kcpp('%ws')\n", parsedFiles[f].path.c_str());
+			parseInputFile(parsedFiles[f]);
+			kwatchCollectAffectedOutputs(parsedFiles[f], affectedPtus,
+			                             kassetsAffected);
+		}
+		mergeParsedFiles(parsedFiles);
+		bool ptuRemoved = false;
+		for(const TaggedUnionStructIdentifier ptuId : affectedPtus)
+		{
+			const uint32_t ptu = kptuFindPtu(g_ptuDatabase, ptuId);
+			if(ptu == KPTU_INVALID_INDEX)
+				ptuRemoved = true;
+			else
+				writePolymorphicTaggedUnionFiles(fsPathOutput, g_ptuDatabase,
+				                                 ptu);
+		}
+		if(ptuRemoved)
+			removeStaleGeneratedFiles(fsPathOutput);
+		if(kassetsAffected)
+			writeKAssetFiles(fsPathOutput);
+		const auto timeEnd = chrono::high_resolution_clock::now();
+		printf("kcpp: %zu file(s) changed, %zu PTU(s) affected. "
+		       "Seconds elapsed=%f\n",
+		       reparseFileIndices.size() + removedFileCount,
+		       affectedPtus.size(),
+		       chrono::duration<double>(timeEnd - timeStart).count());
+		fflush(stdout);
+	}
+}